@@ -0,0 +1,414 @@
+#include "TOFasyncIO.h"
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define colorRed     "\033[1;31m"
+#define colorYellow  "\033[1;33m"
+#define colorBlue    "\033[1;34m"
+
+namespace tof {
+namespace data {
+
+/** TOFasyncIO **/
+
+TOFasyncIO::~TOFasyncIO()
+{
+  if (mRingFD != -1) uringRelease();
+  if (mThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    mQueueCondition.notify_all();
+    mThread.join();
+  }
+}
+
+bool
+TOFasyncIO::init(int depth, bool useUring)
+{
+  if (useUring && !uringInit(depth)) {
+    std::cout << colorBlue
+	      << "--- INITIALISE ASYNC IO: io_uring, depth " << depth
+	      << std::endl;
+    return false;
+  }
+  std::cout << colorBlue
+	    << "--- INITIALISE ASYNC IO: helper thread"
+	    << std::endl;
+  mThread = std::thread(&TOFasyncIO::threadLoop, this);
+  return false;
+}
+
+bool
+TOFasyncIO::submit(Request *request)
+{
+  request->Done = false;
+  request->Result = 0;
+  if (mRingFD != -1) return uringSubmit(request);
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mQueue.push_back(request);
+  }
+  mQueueCondition.notify_one();
+  return false;
+}
+
+bool
+TOFasyncIO::wait(Request *request)
+{
+  if (mRingFD != -1) {
+    while (!request->Done)
+      if (uringReap()) return true;
+    return false;
+  }
+  std::unique_lock<std::mutex> lock(mMutex);
+  mDoneCondition.wait(lock, [request] { return request->Done; });
+  return false;
+}
+
+bool
+TOFasyncIO::uringInit(int depth)
+{
+  struct io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  int fd = syscall(__NR_io_uring_setup, depth, &params);
+  if (fd < 0) {
+    std::cout << colorYellow
+	      << "-W- io_uring not available: " << std::strerror(errno)
+	      << std::endl;
+    return true;
+  }
+  mRingFD = fd;
+
+  /** map submission and completion rings, possibly in a single mapping **/
+  mSQRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  mCQRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  mSQEsSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single) mSQRingSize = mCQRingSize = std::max(mSQRingSize, mCQRingSize);
+  mSQRing = mmap(nullptr, mSQRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  mCQRing = single ? mSQRing : mmap(nullptr, mCQRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  mSQEs = mmap(nullptr, mSQEsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (mSQRing == MAP_FAILED || mCQRing == MAP_FAILED || mSQEs == MAP_FAILED) {
+    std::cout << colorYellow
+	      << "-W- cannot map io_uring rings: " << std::strerror(errno)
+	      << std::endl;
+    uringRelease();
+    return true;
+  }
+
+  mSQTail  = (uint32_t *)((char *)mSQRing + params.sq_off.tail);
+  mSQMask  = (uint32_t *)((char *)mSQRing + params.sq_off.ring_mask);
+  mSQArray = (uint32_t *)((char *)mSQRing + params.sq_off.array);
+  mCQHead  = (uint32_t *)((char *)mCQRing + params.cq_off.head);
+  mCQTail  = (uint32_t *)((char *)mCQRing + params.cq_off.tail);
+  mCQMask  = (uint32_t *)((char *)mCQRing + params.cq_off.ring_mask);
+  mCQEs    = (char *)mCQRing + params.cq_off.cqes;
+  return false;
+}
+
+void
+TOFasyncIO::uringRelease()
+{
+  if (mSQEs && mSQEs != MAP_FAILED) munmap(mSQEs, mSQEsSize);
+  if (mCQRing && mCQRing != MAP_FAILED && mCQRing != mSQRing) munmap(mCQRing, mCQRingSize);
+  if (mSQRing && mSQRing != MAP_FAILED) munmap(mSQRing, mSQRingSize);
+  mSQEs = mCQRing = mSQRing = nullptr;
+  ::close(mRingFD);
+  mRingFD = -1;
+}
+
+bool
+TOFasyncIO::uringSubmit(Request *request)
+{
+  /** only this thread produces submissions, the kernel consumes them **/
+  uint32_t tail = *mSQTail;
+  uint32_t index = tail & *mSQMask;
+  auto sqe = (struct io_uring_sqe *)mSQEs + index;
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = request->Write ? IORING_OP_WRITE : IORING_OP_READ;
+  sqe->fd = request->FD;
+  sqe->addr = (uint64_t)request->Buffer;
+  sqe->len = request->Size;
+  sqe->off = request->Offset;
+  sqe->user_data = (uint64_t)request;
+  mSQArray[index] = index;
+  __atomic_store_n(mSQTail, tail + 1, __ATOMIC_RELEASE);
+  if (syscall(__NR_io_uring_enter, mRingFD, 1, 0, 0, nullptr, 0) < 0) {
+    std::cerr << colorRed
+	      << "-E- io_uring submit failed: " << std::strerror(errno)
+	      << std::endl;
+    return true;
+  }
+  return false;
+}
+
+bool
+TOFasyncIO::uringReap()
+{
+  uint32_t head = *mCQHead;
+  uint32_t tail = __atomic_load_n(mCQTail, __ATOMIC_ACQUIRE);
+  if (head == tail) {
+    if (syscall(__NR_io_uring_enter, mRingFD, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+      std::cerr << colorRed
+		<< "-E- io_uring wait failed: " << std::strerror(errno)
+		<< std::endl;
+      return true;
+    }
+    return false;
+  }
+  for (; head != tail; ++head) {
+    auto cqe = (struct io_uring_cqe *)mCQEs + (head & *mCQMask);
+    auto request = (Request *)cqe->user_data;
+    request->Result = cqe->res;
+    request->Done = true;
+  }
+  __atomic_store_n(mCQHead, head, __ATOMIC_RELEASE);
+  return false;
+}
+
+void
+TOFasyncIO::threadLoop()
+{
+  while (true) {
+    Request *request;
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mQueueCondition.wait(lock, [this] { return mStop || !mQueue.empty(); });
+      if (mQueue.empty()) return;
+      request = mQueue.front();
+      mQueue.pop_front();
+    }
+    long result = request->Write ?
+      pwrite(request->FD, request->Buffer, request->Size, request->Offset) :
+      pread(request->FD, request->Buffer, request->Size, request->Offset);
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      request->Result = result < 0 ? -errno : result;
+      request->Done = true;
+    }
+    mDoneCondition.notify_all();
+  }
+}
+
+/** TOFasyncReader **/
+
+bool
+TOFasyncReader::open(std::string name, int nBuffers, long bufferSize, bool direct)
+{
+  if (isOpen()) close();
+  mFD = ::open(name.c_str(), O_RDONLY | (direct ? O_DIRECT : 0));
+  if (mFD == -1 && direct) {
+    std::cout << colorYellow
+	      << "-W- cannot open input file with O_DIRECT, using buffered IO: " << name
+	      << std::endl;
+    direct = false;
+    mFD = ::open(name.c_str(), O_RDONLY);
+  }
+  if (mFD == -1) {
+    std::cerr << colorRed
+	      << "-E- Cannot open input file: " << name
+	      << std::endl;
+    return true;
+  }
+  mDirect = direct;
+  mBufferSize = (bufferSize + Alignment - 1) / Alignment * Alignment;
+  mOffset = 0;
+  mCurrent = mPrevious = -1;
+  mSlots.assign(nBuffers, Slot());
+  for (auto &slot : mSlots) {
+    void *memory;
+    slot.Memory = nullptr;
+    slot.Pending = false;
+    if (posix_memalign(&memory, Alignment, Headroom + mBufferSize)) {
+      std::cerr << colorRed
+		<< "-E- Cannot allocate read buffer"
+		<< std::endl;
+      return true;
+    }
+    slot.Memory = (char *)memory;
+  }
+  for (auto &slot : mSlots)
+    if (submit(slot)) return true;
+  return false;
+}
+
+bool
+TOFasyncReader::submit(Slot &slot)
+{
+  slot.Request.FD = mFD;
+  slot.Request.Buffer = slot.Memory + Headroom;
+  slot.Request.Size = mBufferSize;
+  slot.Request.Offset = mOffset;
+  slot.Request.Write = false;
+  mOffset += mBufferSize;
+  slot.Pending = true;
+  return mIO.submit(&slot.Request);
+}
+
+char *
+TOFasyncReader::next(long &size)
+{
+  size = 0;
+  if (mSlots.empty()) return nullptr;
+  int inext = (mCurrent + 1) % mSlots.size();
+  auto &slot = mSlots[inext];
+  if (!slot.Pending) return nullptr;
+  if (mIO.wait(&slot.Request)) return nullptr;
+  slot.Pending = false;
+  size = slot.Request.Result;
+  if (size < 0) {
+    std::cerr << colorRed
+	      << "-E- async read failed: " << std::strerror(-size)
+	      << std::endl;
+    size = 0;
+    return nullptr;
+  }
+  /** complete a short read, unless at end of file **/
+  while (!mDirect && size > 0 && size < mBufferSize) {
+    long nread = pread(mFD, slot.Request.Buffer + size, mBufferSize - size, slot.Request.Offset + size);
+    if (nread <= 0) break;
+    size += nread;
+  }
+  if (size == 0) return nullptr;
+  mPrevious = mCurrent;
+  mCurrent = inext;
+  return slot.Request.Buffer;
+}
+
+bool
+TOFasyncReader::recycle()
+{
+  if (mPrevious == -1) return false;
+  auto &slot = mSlots[mPrevious];
+  mPrevious = -1;
+  return submit(slot);
+}
+
+bool
+TOFasyncReader::close()
+{
+  if (!isOpen()) return true;
+  for (auto &slot : mSlots) {
+    if (slot.Pending) mIO.wait(&slot.Request);
+    free(slot.Memory);
+  }
+  mSlots.clear();
+  ::close(mFD);
+  mFD = -1;
+  return false;
+}
+
+/** TOFasyncWriter **/
+
+bool
+TOFasyncWriter::open(std::string name, int nBuffers, long bufferSize)
+{
+  if (isOpen()) close();
+  mFD = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (mFD == -1) {
+    std::cerr << colorRed << "-E- Cannot open output file: " << name
+	      << std::endl;
+    return true;
+  }
+  mBufferSize = bufferSize;
+  mOffset = 0;
+  mCurrent = 0;
+  mSlots.assign(nBuffers, Slot());
+  for (auto &slot : mSlots) {
+    void *memory;
+    slot.Memory = nullptr;
+    slot.Fill = 0;
+    slot.Pending = false;
+    if (posix_memalign(&memory, TOFasyncReader::Alignment, mBufferSize)) {
+      std::cerr << colorRed
+		<< "-E- Cannot allocate write buffer"
+		<< std::endl;
+      return true;
+    }
+    slot.Memory = (char *)memory;
+  }
+  return false;
+}
+
+bool
+TOFasyncWriter::write(const char *data, long size)
+{
+  while (size > 0) {
+    auto &slot = mSlots[mCurrent];
+    long n = std::min(size, mBufferSize - slot.Fill);
+    std::memcpy(slot.Memory + slot.Fill, data, n);
+    slot.Fill += n;
+    data += n;
+    size -= n;
+    if (slot.Fill == mBufferSize && flush()) return true;
+  }
+  return false;
+}
+
+bool
+TOFasyncWriter::flush()
+{
+  auto &slot = mSlots[mCurrent];
+  if (slot.Fill == 0) return false;
+  slot.Request.FD = mFD;
+  slot.Request.Buffer = slot.Memory;
+  slot.Request.Size = slot.Fill;
+  slot.Request.Offset = mOffset;
+  slot.Request.Write = true;
+  mOffset += slot.Fill;
+  slot.Pending = true;
+  if (mIO.submit(&slot.Request)) return true;
+  /** move on to the next buffer, waiting for its previous write if needed **/
+  mCurrent = (mCurrent + 1) % mSlots.size();
+  return complete(mSlots[mCurrent]);
+}
+
+bool
+TOFasyncWriter::complete(Slot &slot)
+{
+  if (!slot.Pending) return false;
+  slot.Pending = false;
+  if (mIO.wait(&slot.Request)) return true;
+  long written = slot.Request.Result;
+  /** complete a short write synchronously **/
+  while (written >= 0 && written < slot.Request.Size) {
+    long n = pwrite(mFD, slot.Request.Buffer + written, slot.Request.Size - written, slot.Request.Offset + written);
+    if (n <= 0) { written = -1; break; }
+    written += n;
+  }
+  slot.Fill = 0;
+  if (written < 0) {
+    std::cerr << colorRed
+	      << "-E- async write failed"
+	      << std::endl;
+    return true;
+  }
+  return false;
+}
+
+bool
+TOFasyncWriter::close()
+{
+  if (!isOpen()) return true;
+  bool status = flush();
+  for (auto &slot : mSlots) {
+    if (complete(slot)) status = true;
+    free(slot.Memory);
+  }
+  mSlots.clear();
+  ::close(mFD);
+  mFD = -1;
+  return status;
+}
+
+}}
@@ -0,0 +1,166 @@
+#ifndef _TOF_ASYNCIO_H_
+#define _TOF_ASYNCIO_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+namespace tof {
+namespace data {
+
+/**
+ ** asynchronous positional read/write requests
+ ** backed by io_uring, or by a helper thread doing pread/pwrite
+ ** when io_uring is not available; requests are submitted and
+ ** waited for by a single thread
+ **/
+
+class TOFasyncIO {
+
+public:
+
+  struct Request {
+    int   FD;
+    char *Buffer;
+    long  Size;
+    long  Offset;
+    bool  Write;
+    long  Result;
+    bool  Done;
+  };
+
+  TOFasyncIO() {};
+  ~TOFasyncIO();
+
+  bool init(int depth, bool useUring = true);
+  bool submit(Request *request);
+  bool wait(Request *request);
+  bool isUring() const { return mRingFD != -1; };
+
+private:
+
+  /** io_uring backend **/
+
+  bool uringInit(int depth);
+  void uringRelease();
+  bool uringSubmit(Request *request);
+  bool uringReap();
+
+  int       mRingFD       = -1;
+  void     *mSQRing       = nullptr;
+  void     *mCQRing       = nullptr;
+  void     *mSQEs         = nullptr;
+  long      mSQRingSize   = 0;
+  long      mCQRingSize   = 0;
+  long      mSQEsSize     = 0;
+  uint32_t *mSQTail       = nullptr;
+  uint32_t *mSQMask       = nullptr;
+  uint32_t *mSQArray      = nullptr;
+  uint32_t *mCQHead       = nullptr;
+  uint32_t *mCQTail       = nullptr;
+  uint32_t *mCQMask       = nullptr;
+  void     *mCQEs         = nullptr;
+
+  /** helper thread backend **/
+
+  void threadLoop();
+
+  std::thread             mThread;
+  std::deque<Request *>   mQueue;
+  std::mutex              mMutex;
+  std::condition_variable mQueueCondition;
+  std::condition_variable mDoneCondition;
+  bool                    mStop = false;
+
+};
+
+/**
+ ** read-ahead reader keeping a ring of aligned buffers in flight
+ ** each buffer has Headroom bytes in front of its data, where the
+ ** caller can stitch the incomplete page left over from the previous one
+ **/
+
+class TOFasyncReader {
+
+public:
+
+  TOFasyncReader(TOFasyncIO &io) : mIO(io) {};
+  ~TOFasyncReader() { close(); };
+
+  bool open(std::string name, int nBuffers, long bufferSize, bool direct);
+  bool close();
+  bool isOpen() const { return mFD != -1; };
+  /** wait for the next buffer in file order, nullptr at end of file **/
+  char *next(long &size);
+  /** give the buffer returned before the last next() back for reading **/
+  bool recycle();
+
+  static const long Headroom = 65536;
+  static const long Alignment = 4096;
+
+private:
+
+  struct Slot {
+    char               *Memory;
+    TOFasyncIO::Request Request;
+    bool                Pending;
+  };
+
+  bool submit(Slot &slot);
+
+  TOFasyncIO       &mIO;
+  int               mFD         = -1;
+  bool              mDirect     = false;
+  long              mBufferSize = 0;
+  long              mOffset     = 0;
+  std::vector<Slot> mSlots;
+  int               mCurrent    = -1;
+  int               mPrevious   = -1;
+
+};
+
+/**
+ ** write-behind writer, data are collected in aligned buffers that
+ ** are submitted when full while the next one is being filled
+ **/
+
+class TOFasyncWriter {
+
+public:
+
+  TOFasyncWriter(TOFasyncIO &io) : mIO(io) {};
+  ~TOFasyncWriter() { close(); };
+
+  bool open(std::string name, int nBuffers, long bufferSize);
+  bool close();
+  bool isOpen() const { return mFD != -1; };
+  bool write(const char *data, long size);
+
+private:
+
+  struct Slot {
+    char               *Memory;
+    long                Fill;
+    TOFasyncIO::Request Request;
+    bool                Pending;
+  };
+
+  bool flush();
+  bool complete(Slot &slot);
+
+  TOFasyncIO       &mIO;
+  int               mFD         = -1;
+  long              mBufferSize = 0;
+  long              mOffset     = 0;
+  std::vector<Slot> mSlots;
+  int               mCurrent    = 0;
+
+};
+
+}}
+
+#endif /** _TOF_ASYNCIO_H_ **/
@@ -0,0 +1,318 @@
+#include "TOFbenchmark.h"
+#include "TOFpageWalker.h"
+#include <iostream>
+#include <functional>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define colorRed     "\033[1;31m"
+#define colorYellow  "\033[1;33m"
+
+namespace tof {
+namespace data {
+
+TOFbenchmark::TOFbenchmark()
+{
+  openCounters();
+}
+
+TOFbenchmark::~TOFbenchmark()
+{
+  if (mInstructionsFD != -1) ::close(mInstructionsFD);
+  if (mCyclesFD != -1) ::close(mCyclesFD);
+}
+
+void
+TOFbenchmark::openCounters()
+{
+  struct perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  mInstructionsFD = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  attr.config = PERF_COUNT_HW_CPU_CYCLES;
+  mCyclesFD = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  if (mInstructionsFD == -1 || mCyclesFD == -1) {
+    std::cout << colorYellow
+	      << "-W- hardware counters not available, IPC will not be measured"
+	      << std::endl;
+    if (mInstructionsFD != -1) ::close(mInstructionsFD);
+    if (mCyclesFD != -1) ::close(mCyclesFD);
+    mInstructionsFD = mCyclesFD = -1;
+  }
+}
+
+bool
+TOFbenchmark::readCounters(double &instructions, double &cycles)
+{
+  if (mInstructionsFD == -1) return true;
+  uint64_t value;
+  if (::read(mInstructionsFD, &value, sizeof(value)) != sizeof(value)) return true;
+  instructions = value;
+  if (::read(mCyclesFD, &value, sizeof(value)) != sizeof(value)) return true;
+  cycles = value;
+  return false;
+}
+
+bool
+TOFbenchmark::prepare(const std::vector<char> &raw)
+{
+  mPages.clear();
+  mEvents.clear();
+  mTRMs.clear();
+  mHitWords.clear();
+  mHitChains.clear();
+  mRecordedEvents = 0;
+  mBytes = raw.size();
+
+  /** decode each page once, recording what the checker reads after each event **/
+  TOFpageWalker walker(raw.data(), raw.data() + raw.size());
+  long maxPage = 0;
+  while (!walker.next()) {
+    auto page = walker.page();
+    mPages.push_back(page);
+    if (walker.pageSize() > maxPage) maxPage = walker.pageSize();
+    long first = mEvents.size();
+    mDecoderPage = (char *)page;
+    decoderRewind();
+    decodeRDH();
+    while (!decode()) {
+      EventRecord event;
+      event.DRMOrbitHeader   = mRawSummary.DRMOrbitHeader;
+      event.DRMGlobalHeader  = mRawSummary.DRMGlobalHeader;
+      event.DRMStatusHeader1 = mRawSummary.DRMStatusHeader1;
+      event.DRMStatusHeader2 = mRawSummary.DRMStatusHeader2;
+      event.DRMStatusHeader3 = mRawSummary.DRMStatusHeader3;
+      event.DRMGlobalTrailer = mRawSummary.DRMGlobalTrailer;
+      std::memcpy(event.TRMGlobalHeader, mRawSummary.TRMGlobalHeader, sizeof(event.TRMGlobalHeader));
+      std::memcpy(event.TRMGlobalTrailer, mRawSummary.TRMGlobalTrailer, sizeof(event.TRMGlobalTrailer));
+      std::memcpy(event.TRMChainHeader, mRawSummary.TRMChainHeader, sizeof(event.TRMChainHeader));
+      std::memcpy(event.TRMChainTrailer, mRawSummary.TRMChainTrailer, sizeof(event.TRMChainTrailer));
+      std::memcpy(event.HasHits, mRawSummary.HasHits, sizeof(event.HasHits));
+      std::memcpy(event.HasErrors, mRawSummary.HasErrors, sizeof(event.HasErrors));
+      /** TRMs of a past generation are not in this event **/
+      for (int itrm = 0; itrm < 10; ++itrm) {
+	if (mRawSummary.TRMGeneration[itrm] == mRawSummary.Generation) continue;
+	event.TRMGlobalHeader[itrm] = event.TRMGlobalTrailer[itrm] = 0x0;
+	event.HasHits[itrm] = false;
+	for (int ichain = 0; ichain < 2; ++ichain) {
+	  event.TRMChainHeader[itrm][ichain] = event.TRMChainTrailer[itrm][ichain] = 0x0;
+	  event.HasErrors[itrm][ichain] = false;
+	}
+      }
+      event.FirstTRM = event.LastTRM = 0;
+      mEvents.push_back(event);
+    }
+    recordTRMs(page, first);
+  }
+  if (walker.error() || mEvents.empty() || mRecordedEvents != (long)mEvents.size()) {
+    std::cerr << colorRed
+	      << "-E- benchmark input cannot be replayed: " << mEvents.size() << " decoded events, " << mRecordedEvents << " recorded"
+	      << std::endl;
+    return true;
+  }
+
+  /** an event cannot encode more than it reads **/
+  mScratch.resize(maxPage / 4 + 16);
+  return false;
+}
+
+void
+TOFbenchmark::recordTRMs(const char *page, long firstEvent)
+{
+  /** payload words, two per GBT word, as the decoder walks them **/
+  auto rdh = reinterpret_cast<const raw::RDHWord0_t *>(page);
+  auto pointer = reinterpret_cast<const uint32_t *>(page + TOFpageWalker::RDHSize);
+  auto end = reinterpret_cast<const uint32_t *>(page + rdh->MemorySize);
+  long ievent = firstEvent;
+  int slotID = -1, ichain = -1;
+  bool inEvent = false;
+  for (int step = 1; pointer < end; pointer += step, step = 4 - step) {
+    auto word = *pointer;
+    if (!inEvent) {
+      if (IS_DRM_GLOBAL_HEADER(word) && ievent < (long)mEvents.size()) {
+	inEvent = true;
+	mEvents[ievent].FirstTRM = mTRMs.size();
+      }
+      continue;
+    }
+    if (ichain != -1) {
+      if (IS_TDC_HIT(word)) {
+	mHitWords.push_back(word);
+	mHitChains.push_back(ichain);
+	continue;
+      }
+      if (IS_TDC_ERROR(word)) continue;
+      ichain = -1;
+      if (IS_TRM_CHAINA_TRAILER(word) || IS_TRM_CHAINB_TRAILER(word)) continue;
+    }
+    if (IS_DRM_GLOBAL_TRAILER(word)) {
+      mEvents[ievent].LastTRM = mTRMs.size();
+      ievent++;
+      mRecordedEvents++;
+      inEvent = false;
+      slotID = -1;
+      continue;
+    }
+    if (IS_TRM_GLOBAL_HEADER(word) && GET_TRMGLOBALHEADER_SLOTID(word) > 2) {
+      slotID = GET_TRMGLOBALHEADER_SLOTID(word);
+      TRMRecord trm = {(uint32_t)slotID, (long)mHitWords.size(), (long)mHitWords.size()};
+      mTRMs.push_back(trm);
+      continue;
+    }
+    if (slotID == -1) continue;
+    if (IS_TRM_CHAINA_HEADER(word) && (int)GET_TRMCHAINHEADER_SLOTID(word) == slotID) ichain = 0;
+    else if (IS_TRM_CHAINB_HEADER(word) && (int)GET_TRMCHAINHEADER_SLOTID(word) == slotID) ichain = 1;
+    else if (IS_TRM_GLOBAL_TRAILER(word)) {
+      mTRMs.back().End = mHitWords.size();
+      slotID = -1;
+    }
+  }
+}
+
+void
+TOFbenchmark::pass(int flags)
+{
+  for (auto &event : mEvents) {
+
+    /** replay the event **/
+    mRawSummary.DRMOrbitHeader   = event.DRMOrbitHeader;
+    mRawSummary.DRMGlobalHeader  = event.DRMGlobalHeader;
+    mRawSummary.DRMStatusHeader1 = event.DRMStatusHeader1;
+    mRawSummary.DRMStatusHeader2 = event.DRMStatusHeader2;
+    mRawSummary.DRMStatusHeader3 = event.DRMStatusHeader3;
+    mRawSummary.DRMGlobalTrailer = event.DRMGlobalTrailer;
+    std::memcpy(mRawSummary.TRMGlobalHeader, event.TRMGlobalHeader, sizeof(event.TRMGlobalHeader));
+    std::memcpy(mRawSummary.TRMGlobalTrailer, event.TRMGlobalTrailer, sizeof(event.TRMGlobalTrailer));
+    std::memcpy(mRawSummary.TRMChainHeader, event.TRMChainHeader, sizeof(event.TRMChainHeader));
+    std::memcpy(mRawSummary.TRMChainTrailer, event.TRMChainTrailer, sizeof(event.TRMChainTrailer));
+    std::memcpy(mRawSummary.HasHits, event.HasHits, sizeof(event.HasHits));
+    std::memcpy(mRawSummary.HasErrors, event.HasErrors, sizeof(event.HasErrors));
+    /** the record holds every TRM of the event **/
+    mRawSummary.Generation++;
+    for (auto &generation : mRawSummary.TRMGeneration)
+      generation = mRawSummary.Generation;
+
+    if (flags & kEncoder) {
+      mEncoderEvent = (char *)mScratch.data();
+      encoderRewind();
+      encoderCrateHeader();
+    }
+
+    for (int itrm = event.FirstTRM; (flags & kHits) && itrm < event.LastTRM; ++itrm) {
+      auto &trm = mTRMs[itrm];
+      if (trm.Begin == trm.End) continue;
+
+      /** unpacked hits as the decoder stores them **/
+      for (long ihit = trm.Begin; ihit < trm.End; ++ihit) {
+	auto ichain = mHitChains[ihit];
+	auto itdc = GET_TDCHIT_TDCID(mHitWords[ihit]);
+	auto jhit = mHitSummary->nTDCUnpackedHits[ichain][itdc];
+	mHitSummary->TDCUnpackedHit[ichain][itdc][jhit] = mHitWords[ihit];
+	mHitSummary->nTDCUnpackedHits[ichain][itdc]++;
+      }
+
+      if (!(flags & kSpider)) {
+	std::memset(mHitSummary->nTDCUnpackedHits, 0, sizeof(mHitSummary->nTDCUnpackedHits));
+	continue;
+      }
+      spider();
+      if (flags & kEncoder)
+	encoderFrames(trm.SlotID);
+    }
+
+    if (flags & kCheck)
+      check();
+
+    if (flags & kEncoder)
+      encoderCrateTrailer();
+  }
+}
+
+void
+TOFbenchmark::measure(Result_t &result, int flags, double minTime)
+{
+  TOFsegments output;
+  std::function<void()> body;
+  if (flags < 0)
+    body = [this, &output] { for (auto page : mPages) decodePage(page, output); output.clear(); };
+  else
+    body = [this, flags] { pass(flags); };
+
+  /** warm-up, then keep the best pass **/
+  body();
+  result.Events = mEvents.size();
+  result.Hits = mHitWords.size();
+  result.Bytes = mBytes;
+  result.Passes = 0;
+  result.Seconds = -1.;
+  double elapsed = 0.;
+  while (elapsed < minTime || result.Passes < 3) {
+    if (mInstructionsFD != -1) {
+      ioctl(mInstructionsFD, PERF_EVENT_IOC_RESET, 0);
+      ioctl(mCyclesFD, PERF_EVENT_IOC_RESET, 0);
+      ioctl(mInstructionsFD, PERF_EVENT_IOC_ENABLE, 0);
+      ioctl(mCyclesFD, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    auto start = std::chrono::steady_clock::now();
+    body();
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    if (mInstructionsFD != -1) {
+      ioctl(mInstructionsFD, PERF_EVENT_IOC_DISABLE, 0);
+      ioctl(mCyclesFD, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    elapsed += seconds.count();
+    result.Passes++;
+    if (result.Seconds < 0. || seconds.count() < result.Seconds) {
+      result.Seconds = seconds.count();
+      if (readCounters(result.Instructions, result.Cycles))
+	result.Instructions = result.Cycles = -1.;
+    }
+  }
+}
+
+bool
+TOFbenchmark::run(std::vector<Result_t> &results, double minTime)
+{
+  Result_t decode, base, hits, spider, check, spiderCheck, all;
+  measure(decode, -1, minTime);
+  measure(base, 0, minTime);
+  measure(hits, kHits, minTime);
+  measure(spider, kHits | kSpider, minTime);
+  measure(check, kCheck, minTime);
+  measure(spiderCheck, kHits | kSpider | kCheck, minTime);
+  measure(all, kHits | kSpider | kCheck | kEncoder, minTime);
+
+  /** stage = pass with the stage - pass without it **/
+  auto subtract = [](Result_t &result, const Result_t &baseline) {
+    result.Seconds = std::max(result.Seconds - baseline.Seconds, 0.);
+    if (result.Instructions >= 0. && baseline.Instructions >= 0.) {
+      result.Instructions = std::max(result.Instructions - baseline.Instructions, 0.);
+      result.Cycles = std::max(result.Cycles - baseline.Cycles, 0.);
+    }
+  };
+  subtract(spider, hits);
+  subtract(check, base);
+  subtract(all, spiderCheck);
+
+  decode.Stage = "decode";
+  spider.Stage = "spider";
+  check.Stage = "check";
+  all.Stage = "encoder";
+  results.push_back(decode);
+  results.push_back(spider);
+  results.push_back(check);
+  results.push_back(all);
+  return false;
+}
+
+}}
@@ -0,0 +1,103 @@
+#ifndef _TOF_BENCHMARK_H_
+#define _TOF_BENCHMARK_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "TOFdecomp.h"
+
+namespace tof {
+namespace data {
+
+/**
+ ** microbenchmarks of the decoder stages
+ ** raw data in memory are decoded once to record, for each event, the
+ ** words the checker looks at and the TDC hits of each TRM; the stages
+ ** are then timed on their own by replaying these records, the cost of
+ ** the replay is measured in a baseline pass and subtracted
+ **/
+
+class TOFbenchmark : public TOFdecomp {
+
+public:
+
+  struct Result_t {
+    std::string Stage;
+    long        Events       = 0;
+    long        Hits         = 0;
+    long        Bytes        = 0;
+    long        Passes       = 0;
+    double      Seconds      = 0.;  // best pass
+    double      Instructions = -1.; // per pass, negative if not available
+    double      Cycles       = -1.;
+  };
+
+  TOFbenchmark();
+  ~TOFbenchmark();
+
+  /** record the events of the raw pages in the buffer **/
+  bool prepare(const std::vector<char> &raw);
+  /** run all stages, each for at least the given time **/
+  bool run(std::vector<Result_t> &results, double minTime);
+
+  long getEvents() const { return mEvents.size(); };
+  long getHits() const { return mHitWords.size(); };
+
+private:
+
+  enum EPass_t {
+    kHits    = 0x1,
+    kSpider  = 0x2,
+    kCheck   = 0x4,
+    kEncoder = 0x8
+  };
+
+  /** what check() reads from the raw summary **/
+  struct EventRecord {
+    uint32_t DRMOrbitHeader;
+    uint32_t DRMGlobalHeader;
+    uint32_t DRMStatusHeader1;
+    uint32_t DRMStatusHeader2;
+    uint32_t DRMStatusHeader3;
+    uint32_t DRMGlobalTrailer;
+    uint32_t TRMGlobalHeader[10];
+    uint32_t TRMGlobalTrailer[10];
+    uint32_t TRMChainHeader[10][2];
+    uint32_t TRMChainTrailer[10][2];
+    bool     HasHits[10];
+    bool     HasErrors[10][2];
+    int      FirstTRM;
+    int      LastTRM;
+  };
+
+  /** TDC hits of one TRM, a range in the flat hit arrays **/
+  struct TRMRecord {
+    uint32_t SlotID;
+    long     Begin;
+    long     End;
+  };
+
+  void recordTRMs(const char *page, long firstEvent);
+  void pass(int flags);
+  void measure(Result_t &result, int flags, double minTime);
+  void openCounters();
+  bool readCounters(double &instructions, double &cycles);
+
+  std::vector<const char *> mPages;
+  long                      mBytes = 0;
+  std::vector<EventRecord>  mEvents;
+  std::vector<TRMRecord>    mTRMs;
+  long                      mRecordedEvents = 0;
+  std::vector<uint32_t>     mHitWords;
+  std::vector<uint8_t>      mHitChains;
+  std::vector<uint32_t>     mScratch;
+
+  /** hardware counters, -1 if not available **/
+  int mInstructionsFD = -1;
+  int mCyclesFD       = -1;
+
+};
+
+}}
+
+#endif /** _TOF_BENCHMARK_H_ **/
@@ -1,16 +1,13 @@
 #include "TOFdecomp.h"
+#include "TOFsimd.h"
+#include "TOFprobe.h"
 #include <iostream>
 #include <chrono>
-
-#ifdef DECODER_VERBOSE
-#warning "Building code with DecoderVerbose option. This may limit the speed."
-#endif
-#ifdef ENCODER_VERBOSE
-#warning "Building code with EncoderVerbose option. This may limit the speed."
-#endif
-#ifdef CHECKER_VERBOSE
-#warning "Building code with CheckerVerbose option. This may limit the speed."
-#endif
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define colorRed     "\033[1;31m"
 #define colorGreen   "\033[1;32m"
@@ -20,19 +17,97 @@
 namespace tof {
 namespace data {
 
+namespace {
+
+  /** class of a raw word from its top nibble **/
+  enum EWordClass_t {
+    kChainAHeader,
+    kChainATrailer,
+    kChainBHeader,
+    kChainBTrailer,
+    kGlobalHeader,
+    kGlobalTrailer,
+    kTDCError,
+    kFiller,
+    kTDCHit,
+    kNWordClasses
+  };
+
+  constexpr uint8_t sWordClass[16] = {
+    kChainAHeader, kChainATrailer, kChainBHeader, kChainBTrailer,
+    kGlobalHeader, kGlobalTrailer, kTDCError,     kFiller,
+    kTDCHit,       kTDCHit,        kTDCHit,       kTDCHit,
+    kTDCHit,       kTDCHit,        kTDCHit,       kTDCHit
+  };
+
+  /**
+   ** appended to the dense payload of a page, an event running over the
+   ** page end is closed by a DRM global trailer from any decoder state:
+   ** the LTM trailer ends an LTM, the first DRM trailer is skipped by a
+   ** TRM or a chain, the second one closes the event
+   **/
+  constexpr uint32_t sDenseSentinel[16] = {
+    0x50000002, 0x50000001, 0x50000001, 0x70000000,
+    0x50000002, 0x50000001, 0x50000001, 0x70000000,
+    0x50000002, 0x50000001, 0x50000001, 0x70000000,
+    0x50000002, 0x50000001, 0x50000001, 0x70000000
+  };
+
+  /** dense payload of the largest page, the sentinel and a vector of slack **/
+  constexpr long sDenseWords = TOFpageWalker::MaxPageSize / 8 + 16 + 16;
+
+}
+
+/** jump to the handler of the next word in a dispatch table (GNU labels as values) **/
+#define DECODER_DISPATCH(table) goto *table[sWordClass[*mDecoderPointer >> 28]]
+
+
 TOFdecomp::TOFdecomp()
 {
+  /** pages can be decoded without init(), see decodePage() **/
+  void *memory = nullptr;
+  if (posix_memalign(&memory, 64, sDenseWords * sizeof(uint32_t)) == 0)
+    mDecoderDense = reinterpret_cast<uint32_t *>(memory);
+  /** hit storage, counters are cleared as they are consumed **/
+  if (posix_memalign(&memory, 64, sizeof(summary::HitSummary_t)) == 0) {
+    mHitSummary = reinterpret_cast<summary::HitSummary_t *>(memory);
+    std::memset(mHitSummary, 0, sizeof(summary::HitSummary_t));
+  }
 }
 
 TOFdecomp::~TOFdecomp()
 {
+  if (encoderIsOpen()) encoderClose();
+  if (mEncoderThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mEncoderMutex);
+      mEncoderStop = true;
+    }
+    mEncoderCondition.notify_all();
+    mEncoderThread.join();
+  }
+  if (mEncoderAsync) delete mEncoderAsync;
+  if (mDecoderAsync) delete mDecoderAsync;
+  if (mAsyncIO) delete mAsyncIO;
+  if (mDecoderMap) munmap(mDecoderMap, mDecoderMapSize);
+  if (mDecoderFD != -1) ::close(mDecoderFD);
   if (mDecoderBuffer) delete [] mDecoderBuffer;
-  if (mEncoderBuffer) delete [] mEncoderBuffer;
+  if (mDecoderRing) delete mDecoderRing;
+  if (mLatency) delete mLatency;
+  free(mDecoderDense);
+  free(mHitSummary);
 }
 
 bool
 TOFdecomp::init()
 {
+  if (mAsyncDepth > 0 && !mAsyncIO) {
+    /** read-ahead and write-behind buffers share one queue **/
+    mAsyncIO = new TOFasyncIO;
+    if (mAsyncIO->init(2 * mAsyncDepth)) return true;
+    mDecoderAsync = new TOFasyncReader(*mAsyncIO);
+    mEncoderAsync = new TOFasyncWriter(*mAsyncIO);
+  }
   if (decoderInit()) return true;
   if (encoderInit()) return true;
   return false;
@@ -46,6 +121,20 @@ TOFdecomp::open(std::string inFileName, std::string outFileName)
   return false;
 }
 
+bool
+TOFdecomp::open(std::string inFileName, TOFsink &sink)
+{
+  if (decoderOpen(inFileName)) return true;
+  if (encoderIsOpen()) {
+    std::cout << colorYellow
+	      << "-W- an output was already open, closing"
+	      << std::endl;
+    encoderClose();
+  }
+  mEncoderSink = &sink;
+  return false;
+}
+
 bool
 TOFdecomp::close()
 {
@@ -57,47 +146,77 @@ TOFdecomp::close()
 bool
 TOFdecomp::decoderInit()
 {
-#ifdef DECODER_VERBOSE
   if (mDecoderVerbose) {
     std::cout << colorBlue
 	      << "--- INITIALISE DECODER BUFFER: " << mDecoderBufferSize << " bytes"
 	      << std::endl;
   }
-#endif
   if (mDecoderBuffer) {
     std::cout << colorYellow
 	      << "-W- a buffer was already allocated, cleaning\033[0m"
 	      << std::endl;
     delete [] mDecoderBuffer;
   }
+  if (mDecoderBufferSize < TOFpageWalker::MaxPageSize) {
+    std::cout << colorYellow
+	      << "-W- decoder buffer smaller than largest page, enlarging to " << TOFpageWalker::MaxPageSize << " bytes\033[0m"
+	      << std::endl;
+    mDecoderBufferSize = TOFpageWalker::MaxPageSize;
+  }
   mDecoderBuffer = new char[mDecoderBufferSize];
+  mDecoderPage = mDecoderBuffer;
+  mDecoderWalker.reset(mDecoderBuffer, mDecoderBuffer);
   return false;
 }
 
 bool
 TOFdecomp::encoderInit()
 {
-#ifdef ENCODER_VERBOSE
   if (mEncoderVerbose) {
     std::cout << colorBlue
-	      << "--- INITIALISE ENCODER BUFFER: " << mEncoderBufferSize << " bytes"
+	      << "--- INITIALISE ENCODER SEGMENTS: " << mEncoderBufferSize << " bytes"
 	      << std::endl;
   }
-#endif
-  if (mEncoderBuffer) {
+  mEncoderChain[0].setSegmentSize(mEncoderBufferSize);
+  mEncoderChain[1].setSegmentSize(mEncoderBufferSize);
+  mEncoderFlushTime = std::chrono::steady_clock::now();
+  if (mEncoderThreaded && mEncoderAsync) {
     std::cout << colorYellow
-	      << "-W- a buffer was already allocated, cleaning"
+	      << "-W- writer thread not used with asynchronous IO"
 	      << std::endl;
-    delete [] mEncoderBuffer;
+    mEncoderThreaded = false;
   }
-  mEncoderBuffer = new char[mEncoderBufferSize];
-  encoderRewind();
+  if (mEncoderThreaded && !mEncoderThread.joinable())
+    mEncoderThread = std::thread(&TOFdecomp::encoderThreadLoop, this);
   return false;
 }
 
 bool
 TOFdecomp::decoderOpen(std::string name)
 {
+  bool ring = TOFring::isRing(name);
+  if (ring || TOFstream::isStream(name)) {
+    if (mDecoderMapped || mDecoderAsync) {
+      std::cerr << colorRed
+		<< "-E- a stream cannot be memory-mapped or read asynchronously: " << name
+		<< std::endl;
+      return true;
+    }
+  }
+  if (ring) {
+    if (!mDecoderRing) mDecoderRing = new TOFring;
+    return mDecoderRing->attach(name);
+  }
+  if (TOFstream::isStream(name)) {
+    if (mDecoderStream.open(name)) return true;
+    mDecoderWalker.reset(mDecoderBuffer, mDecoderBuffer);
+    return false;
+  }
+  if (mDecoderMapped) return decoderOpenMapped(name);
+  if (mDecoderAsync) {
+    mDecoderWalker.reset(mDecoderBuffer, mDecoderBuffer);
+    return mDecoderAsync->open(name, mAsyncDepth, mDecoderBufferSize, mDecoderDirect);
+  }
   if (mDecoderFile.is_open()) {
     std::cout << colorYellow
 	      << "-W- a file was already open, closing"
@@ -111,20 +230,85 @@ TOFdecomp::decoderOpen(std::string name)
 	      << std::endl;
     return true;
   }
+  mDecoderWalker.reset(mDecoderBuffer, mDecoderBuffer);
+  return false;
+}
+
+bool
+TOFdecomp::decoderOpenMapped(std::string name)
+{
+  if (mDecoderMap) {
+    std::cout << colorYellow
+	      << "-W- a file was already mapped, unmapping"
+	      << std::endl;
+    decoderClose();
+  }
+  mDecoderFD = ::open(name.c_str(), O_RDONLY);
+  if (mDecoderFD == -1) {
+    std::cerr << colorRed
+	      << "-E- Cannot open input file: " << name
+	      << std::endl;
+    return true;
+  }
+  struct stat st;
+  if (fstat(mDecoderFD, &st) == -1 || st.st_size == 0) {
+    std::cerr << colorRed
+	      << "-E- Cannot stat input file or file is empty: " << name
+	      << std::endl;
+    decoderClose();
+    return true;
+  }
+  mDecoderMapSize = st.st_size;
+  void *map = mmap(nullptr, mDecoderMapSize, PROT_READ, MAP_PRIVATE, mDecoderFD, 0);
+  if (map == MAP_FAILED) {
+    std::cerr << colorRed
+	      << "-E- Cannot map input file: " << name
+	      << std::endl;
+    mDecoderMapSize = 0;
+    decoderClose();
+    return true;
+  }
+  mDecoderMap = (char *)map;
+  mDecoderWalker.reset(mDecoderMap, mDecoderMap + mDecoderMapSize);
+  /** the file is walked once from start to end **/
+  madvise(mDecoderMap, mDecoderMapSize, MADV_SEQUENTIAL);
+  madvise(mDecoderMap, mDecoderMapSize, MADV_WILLNEED);
+  if (mDecoderVerbose) {
+    std::cout << colorBlue
+	      << "--- DECODER MAPPED FILE: " << mDecoderMapSize << " bytes"
+	      << std::endl;
+  }
   return false;
 }
 
 bool
 TOFdecomp::encoderOpen(std::string name)
 {
-  if (mEncoderFile.is_open()) {
+  bool stream = TOFstream::isStream(name);
+  if (mEncoderAsync) {
+    if (stream) {
+      std::cerr << colorRed
+		<< "-E- a stream cannot be written asynchronously: " << name
+		<< std::endl;
+      return true;
+    }
+    return mEncoderAsync->open(name, mAsyncDepth, mEncoderAsyncBufferSize);
+  }
+  if (mEncoderFD != -1) {
     std::cout << colorYellow
 	      << "-W- a file was already open, closing"
 	      << std::endl;
-    mEncoderFile.close();
+    encoderClose();
+  }
+  if (stream) {
+    /** the encoder keeps its own descriptor of the stream **/
+    TOFstream output;
+    if (output.openOutput(name)) return true;
+    mEncoderFD = output.dup();
+    return mEncoderFD == -1;
   }
-  mEncoderFile.open(name.c_str(), std::fstream::out | std::fstream::binary);
-  if (!mEncoderFile.is_open()) {
+  mEncoderFD = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (mEncoderFD == -1) {
     std::cerr << colorRed << "-E- Cannot open output file: " << name
 	      << std::endl;
     return true;
@@ -137,6 +321,36 @@ TOFdecomp::encoderOpen(std::string name)
 bool
 TOFdecomp::decoderClose()
 {
+  if (mDecoderRing) {
+    mDecoderRing->release();
+    mDecoderRing->summary();
+    bool status = mDecoderRing->close();
+    delete mDecoderRing;
+    mDecoderRing = nullptr;
+    mDecoderPage = mDecoderBuffer;
+    return status;
+  }
+  if (mDecoderStream.isOpen()) {
+    mDecoderPage = mDecoderBuffer;
+    mDecoderWalker.reset(mDecoderBuffer, mDecoderBuffer);
+    return mDecoderStream.close();
+  }
+  if (mDecoderMapped) {
+    if (mDecoderFD == -1) return true;
+    if (mDecoderMap) munmap(mDecoderMap, mDecoderMapSize);
+    ::close(mDecoderFD);
+    mDecoderMap = nullptr;
+    mDecoderMapSize = 0;
+    mDecoderFD = -1;
+    mDecoderPage = mDecoderBuffer;
+    mDecoderWalker.reset(mDecoderBuffer, mDecoderBuffer);
+    return false;
+  }
+  if (mDecoderAsync) {
+    mDecoderPage = mDecoderBuffer;
+    mDecoderWalker.reset(mDecoderBuffer, mDecoderBuffer);
+    return mDecoderAsync->close();
+  }
   if (mDecoderFile.is_open()) {
     mDecoderFile.close();
     return false;
@@ -147,81 +361,298 @@ TOFdecomp::decoderClose()
 bool
 TOFdecomp::encoderClose()
 {
-  if (mEncoderFile.is_open())
-    mEncoderFile.close();
-  return false;
+  bool status = encoderFlush();
+  encoderWait();
+  mEncoderSink = nullptr;
+  if (mEncoderAsync) return mEncoderAsync->close() || status;
+  if (mEncoderFD != -1) {
+    ::close(mEncoderFD);
+    mEncoderFD = -1;
+  }
+  return status || mEncoderError;
 }
 
 bool
 TOFdecomp::decoderRead()
 {
-  if (!mDecoderFile.is_open()) {
+  if (!decoderIsOpen()) {
     std::cout << colorRed << "-E- no input file is open"
 	      << std::endl;      
     return true;
   }
-  mDecoderFile.read(mDecoderBuffer, mDecoderBufferSize);
+  /** the previous page goes back to the ring, the next one is decoded in place **/
+  if (mDecoderRing) {
+    mDecoderRing->release();
+    long size;
+    auto page = mDecoderRing->next(size);
+    if (!page) {
+      std::cout << colorRed << "--- Nothing else to read"
+		<< std::endl;
+      return true;
+    }
+    mDecoderPage = (char *)page;
+    decoderRewind();
+    if (mDecoderVerbose) {
+      std::cout << colorBlue
+		<< "--- DECODER READ RING PAGE: " << size << " bytes"
+		<< std::endl;
+    }
+    return false;
+  }
+  /** walk to the next page, refill the buffer when no complete page is left **/
+  while (mDecoderWalker.next()) {
+    if (mDecoderWalker.error()) {
+      std::cout << colorRed << "-E- invalid RDH, cannot locate next page"
+		<< std::endl;
+      return true;
+    }
+    if (mDecoderMapped || decoderFill()) {
+      std::cout << colorRed << "--- Nothing else to read"
+		<< std::endl;
+      return true;
+    }
+  }
+  mDecoderPage = (char *)mDecoderWalker.page();
   decoderRewind();
-  if (!mDecoderFile) {
+  if (mDecoderVerbose) {
+    std::cout << colorBlue
+	      << "--- DECODER READ PAGE: " << mDecoderWalker.pageSize() << " bytes"
+	      << std::endl;
+  }
+  return false;
+}
+
+bool
+TOFdecomp::readPages(std::vector<const char *> &pages)
+{
+  pages.clear();
+  if (!decoderIsOpen()) {
+    std::cout << colorRed << "-E- no input file is open"
+	      << std::endl;      
+    return true;
+  }
+  /** all pages available in the ring, at least one, released by the next call **/
+  if (mDecoderRing) {
+    mDecoderRing->release();
+    long size;
+    do {
+      auto page = mDecoderRing->next(size);
+      if (!page) break;
+      pages.push_back(page);
+    } while (mDecoderRing->available());
+    if (!pages.empty()) return false;
     std::cout << colorRed << "--- Nothing else to read"
 	      << std::endl;
-    return true; 
+    return true;
   }
-#ifdef DECODER_VERBOSE
+  /** collect all complete pages, the buffer is refilled by the next call **/
+  while (true) {
+    while (!mDecoderWalker.next())
+      pages.push_back(mDecoderWalker.page());
+    if (!pages.empty()) return false;
+    if (mDecoderWalker.error()) {
+      std::cout << colorRed << "-E- invalid RDH, cannot locate next page"
+		<< std::endl;
+      return true;
+    }
+    if (mDecoderMapped || decoderFill()) {
+      std::cout << colorRed << "--- Nothing else to read"
+		<< std::endl;
+      return true;
+    }
+  }
+}
+
+bool
+TOFdecomp::decoderFill()
+{
+  /** move the incomplete page left at the end of the buffer to the front **/
+  long left = mDecoderWalker.end() - mDecoderWalker.remainder();
+  if (mDecoderStream.isOpen()) {
+    /** a stream delivers what is available, append while a whole page still fits **/
+    char *begin = (char *)mDecoderWalker.remainder();
+    if (mDecoderBuffer + mDecoderBufferSize - begin < TOFpageWalker::MaxPageSize) {
+      if (left > 0) std::memmove(mDecoderBuffer, begin, left);
+      begin = mDecoderBuffer;
+    }
+    long nread = mDecoderStream.read(begin + left, mDecoderBuffer + mDecoderBufferSize - begin - left);
+    if (nread <= 0) return true;
+    mDecoderWalker.reset(begin, begin + left + nread);
+    if (mDecoderVerbose) {
+      std::cout << colorBlue
+		<< "--- DECODER READ STREAM: " << nread << " bytes"
+		<< std::endl;
+    }
+    return false;
+  }
+  if (mDecoderAsync) {
+    long nread;
+    auto data = mDecoderAsync->next(nread);
+    if (!data) return true;
+    /** stitch it in the headroom in front of the new data **/
+    if (left > 0) std::memmove(data - left, mDecoderWalker.remainder(), left);
+    if (mDecoderAsync->recycle()) return true;
+    mDecoderWalker.reset(data - left, data + nread);
+    return false;
+  }
+  if (left > 0) std::memmove(mDecoderBuffer, mDecoderWalker.remainder(), left);
+  mDecoderFile.read(mDecoderBuffer + left, mDecoderBufferSize - left);
+  long nread = mDecoderFile.gcount();
+  mDecoderWalker.reset(mDecoderBuffer, mDecoderBuffer + left + nread);
+  if (nread == 0) return true;
   if (mDecoderVerbose) {
     std::cout << colorBlue
-	      << "--- DECODER READ PAGE: " << mDecoderBufferSize << " bytes"
+	      << "--- DECODER READ BUFFER: " << nread << " bytes"
 	      << std::endl;
   }
-#endif
   return false;
 }
 
+bool
+TOFdecomp::write()
+{
+  if (!mLatency) return encoderWrite();
+  auto start = TOFlatency::now();
+  bool status = encoderWrite();
+  (*mLatency)[TOFlatency::kWrite].record(TOFlatency::now() - start);
+  return status;
+}
+
+bool
+TOFdecomp::write(const std::vector<struct iovec> &iov)
+{
+  if (!mLatency) return encoderWrite(iov);
+  auto start = TOFlatency::now();
+  bool status = encoderWrite(iov);
+  (*mLatency)[TOFlatency::kWrite].record(TOFlatency::now() - start);
+  return status;
+}
+
 bool
 TOFdecomp::encoderWrite()
 {
-#ifdef ENCODER_VERBOSE
   if (mEncoderVerbose) {
     std::cout << colorBlue
-	      << "--- ENCODER WRITE BUFFER: " << mEncoderByteCounter << " bytes"
+	      << "--- ENCODER COMMIT EVENT: " << mEncoderByteCounter << " bytes"
 	      << std::endl;
   }
-#endif
-  mEncoderFile.write(mEncoderBuffer, mEncoderByteCounter);
-  encoderRewind();
+  mEncoderSegments->commit(mEncoderByteCounter);
+  mEncoderByteCounter = 0;
+
+  /** flush policy, on size or on latency **/
+  if (mEncoderSegments->size() >= mEncoderFlushSize)
+    return encoderFlush();
+  if (mEncoderFlushLatency > 0.) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - mEncoderFlushTime;
+    if (elapsed.count() >= mEncoderFlushLatency)
+      return encoderFlush();
+  }
   return false;
 }
 
+bool
+TOFdecomp::encoderFlush()
+{
+  if (mEncoderFlushLatency > 0.)
+    mEncoderFlushTime = std::chrono::steady_clock::now();
+  if (mEncoderSegments->empty()) return false;
+  if (mEncoderVerbose) {
+    std::cout << colorBlue
+	      << "--- ENCODER FLUSH SEGMENTS: " << mEncoderSegments->size() << " bytes"
+	      << std::endl;
+  }
+
+  /** hand the chain over to the writer thread and fill the other one **/
+  if (mEncoderThreaded) {
+    std::unique_lock<std::mutex> lock(mEncoderMutex);
+    mEncoderCondition.wait(lock, [this] { return !mEncoderPending; });
+    mEncoderPending = mEncoderSegments;
+    mEncoderSegments = mEncoderSegments == &mEncoderChain[0] ? &mEncoderChain[1] : &mEncoderChain[0];
+    lock.unlock();
+    mEncoderCondition.notify_all();
+    return mEncoderError;
+  }
+
+  std::vector<struct iovec> iov;
+  mEncoderSegments->gather(iov);
+  bool status = encoderOutput(iov);
+  mEncoderSegments->clear();
+  return status;
+}
+
+void
+TOFdecomp::encoderWait()
+{
+  if (!mEncoderThreaded) return;
+  std::unique_lock<std::mutex> lock(mEncoderMutex);
+  mEncoderCondition.wait(lock, [this] { return !mEncoderPending; });
+}
+
+void
+TOFdecomp::encoderThreadLoop()
+{
+  while (true) {
+    std::unique_lock<std::mutex> lock(mEncoderMutex);
+    mEncoderCondition.wait(lock, [this] { return mEncoderStop || mEncoderPending; });
+    if (!mEncoderPending) return;
+    auto segments = mEncoderPending;
+    lock.unlock();
+    std::vector<struct iovec> iov;
+    segments->gather(iov);
+    bool status = encoderOutput(iov);
+    segments->clear();
+    lock.lock();
+    if (status) mEncoderError = true;
+    mEncoderPending = nullptr;
+    lock.unlock();
+    mEncoderCondition.notify_all();
+  }
+}
+
+bool
+TOFdecomp::encoderWrite(const std::vector<struct iovec> &iov)
+{
+  /** keep the output in order with what is still in the segments **/
+  if (encoderFlush()) return true;
+  encoderWait();
+  return encoderOutput(iov);
+}
+
+bool
+TOFdecomp::encoderOutput(const std::vector<struct iovec> &iov)
+{
+  if (mEncoderSink)
+    return mEncoderSink->write(iov);
+  if (mEncoderAsync) {
+    for (auto &vec : iov)
+      if (mEncoderAsync->write((const char *)vec.iov_base, vec.iov_len)) return true;
+    return false;
+  }
+  return TOFsegments::write(mEncoderFD, iov);
+}
+
 void
 TOFdecomp::decoderClear()
 {
-  mRawSummary.DRMCommonHeader  = 0x0;
-  mRawSummary.DRMOrbitHeader   = 0x0;
-  mRawSummary.DRMGlobalHeader  = 0x0;
-  mRawSummary.DRMStatusHeader1 = 0x0;
-  mRawSummary.DRMStatusHeader2 = 0x0;
-  mRawSummary.DRMStatusHeader3 = 0x0;
-  mRawSummary.DRMStatusHeader4 = 0x0;
-  mRawSummary.DRMStatusHeader5 = 0x0;
+  /** TRM fields are cleared when their TRM shows up, DRM headers are always written before the check **/
+  mRawSummary.Generation++;
   mRawSummary.DRMGlobalTrailer = 0x0;
   mRawSummary.faultFlags = 0x0;
-  for (int itrm = 0; itrm < 10; itrm++) {
-    mRawSummary.TRMGlobalHeader[itrm]  = 0x0;
-    mRawSummary.TRMGlobalTrailer[itrm] = 0x0;
-    mRawSummary.HasHits[itrm] = false;
-    for (int ichain = 0; ichain < 2; ichain++) {
-      mRawSummary.TRMChainHeader[itrm][ichain]  = 0x0;
-      mRawSummary.TRMChainTrailer[itrm][ichain] = 0x0;
-      mRawSummary.HasErrors[itrm][ichain] = false;
-    }}
 }
 
 inline void
-TOFdecomp::decoderNext32()
+TOFdecomp::decoderClearTRM(int itrm)
 {
-  mDecoderPointer += mDecoderNextWord;
-  mDecoderNextWord = (mDecoderNextWord + 2) % 4;
-  mDecoderByteCounter += 4;
+  if (mRawSummary.TRMGeneration[itrm] == mRawSummary.Generation)
+    return;
+  mRawSummary.TRMGeneration[itrm] = mRawSummary.Generation;
+  mRawSummary.TRMGlobalTrailer[itrm] = 0x0;
+  mRawSummary.HasHits[itrm] = false;
+  for (int ichain = 0; ichain < 2; ichain++) {
+    mRawSummary.TRMChainHeader[itrm][ichain]  = 0x0;
+    mRawSummary.TRMChainTrailer[itrm][ichain] = 0x0;
+    mRawSummary.HasErrors[itrm][ichain] = false;
+  }
 }
 
 void
@@ -241,18 +672,23 @@ TOFdecomp::decoderNext128()
 bool
 TOFdecomp::decodeRDH()
 {
+  uint64_t latencyStart = mLatency ? TOFlatency::now() : 0;
   mRDH = reinterpret_cast<raw::RDH_t *>(mDecoderPointer);
+  mDecoderPages++;
+  mDecoderBytes += mRDH->Word0.OffsetNewPacket;
+  if (mMetrics && mMetrics->requested(mMetricsSlot)) {
+    TOFmetrics::Snapshot_t snapshot;
+    getMetrics(snapshot);
+    mMetrics->publish(mMetricsSlot, snapshot);
+  }
     
-#ifdef DECODER_VERBOSE
   if (mDecoderVerbose) {
     std::cout << colorBlue
 	      << "--- DECODE RDH"
 	      << std::endl;    
   }
-#endif
 
   mRawSummary.RDHWord0 = mRDH->Word0;
-#ifdef DECODER_VERBOSE
   if (mDecoderVerbose) {
     uint32_t BlockLength = mRDH->Word0.BlockLength;
     uint32_t PacketCounter = mRDH->Word0.PacketCounter;
@@ -261,22 +697,18 @@ TOFdecomp::decodeRDH()
     printf(" %08x%08x%08x%08x RDH Word0 (MemorySize=%d, PacketCounter=%d) \n", mRDH->Data[3], mRDH->Data[2], mRDH->Data[1], mRDH->Data[0],
 	   MemorySize, PacketCounter);
   }
-#endif
   decoderNext128();
 
   mRawSummary.RDHWord1 = mRDH->Word1;
-#ifdef DECODER_VERBOSE
   if (mDecoderVerbose) {
     uint32_t TrgOrbit = mRDH->Word1.TrgOrbit;
     uint32_t HbOrbit = mRDH->Word1.HbOrbit;
     printf(" %08x%08x%08x%08x RDH Word1 (TrgOrbit=%d, HbOrbit=%d) \n", mRDH->Data[3], mRDH->Data[2], mRDH->Data[1], mRDH->Data[0],
 	   TrgOrbit, HbOrbit);
   }
-#endif
   decoderNext128();
 
   mRawSummary.RDHWord2 = mRDH->Word2;
-#ifdef DECODER_VERBOSE
   if (mDecoderVerbose) {
     uint32_t TrgBC = mRDH->Word2.TrgBC;
     uint32_t HbBC = mRDH->Word2.HbBC;
@@ -284,92 +716,185 @@ TOFdecomp::decodeRDH()
     printf(" %08x%08x%08x%08x RDH Word2 (TrgBC=%d, HbBC=%d, TrgType=%d) \n", mRDH->Data[3], mRDH->Data[2], mRDH->Data[1], mRDH->Data[0],
 	   TrgBC, HbBC, TrgType);
   }
-#endif
   decoderNext128();
 
   mRawSummary.RDHWord3 = mRDH->Word3;
-#ifdef DECODER_VERBOSE
   if (mDecoderVerbose) {
     printf(" %08x%08x%08x%08x RDH Word3 \n", mRDH->Data[3], mRDH->Data[2], mRDH->Data[1], mRDH->Data[0]);
   }
-#endif
   decoderNext128();
 
+  /** the events are decoded from the dense payload **/
+  decoderDepad();
+
+  if (mLatency) {
+    mLatencyPage = TOFlatency::now() - latencyStart;
+    mLatencyPageSpider = mLatencyPageCheck = 0;
+  }
+
   return false;
 }
 
+void
+TOFdecomp::decoderDepad()
+{
+  long size = mDecoderPage + mRawSummary.RDHWord0.MemorySize - (char *)mDecoderPointer;
+  long nwords = size > 0 ? depad(mDecoderPointer, size, mDecoderDense) : 0;
+  std::memcpy(mDecoderDense + nwords, sDenseSentinel, sizeof(sDenseSentinel));
+  mDecoderPointer = mDecoderDense;
+  mDecoderDenseEnd = mDecoderDense + nwords;
+  if (mDecoderVerbose) {
+    std::cout << colorBlue
+	      << "--- DEPAD PAGE: " << nwords << " payload words"
+	      << std::endl;
+  }
+}
+
+inline bool
+TOFdecomp::decoderEventStart(const uint32_t *pointer) const
+{
+  /** DRM common header, orbit, global header and status headers 1-3 **/
+  if (mDecoderDenseEnd - pointer < 9)
+    return false;
+  if (!IS_DRM_COMMON_HEADER(pointer[0]))
+    return false;
+  for (int iword = 2; iword < 6; ++iword)
+    if (!IS_DRM_GLOBAL_HEADER(pointer[iword]))
+      return false;
+  /** the event must fit in the payload declared by the RDH and end with a DRM trailer **/
+  long EventWords = GET_DRMGLOBALHEADER_EVENTWORDS(pointer[2]);
+  if (EventWords < 9 || EventWords > mDecoderDenseEnd - pointer)
+    return false;
+  return IS_DRM_GLOBAL_TRAILER(pointer[EventWords - 1]) || IS_DRM_GLOBAL_TRAILER(pointer[EventWords - 2]);
+}
+
+bool
+TOFdecomp::decoderResync()
+{
+  /** SIMD search of header pairs, each candidate is checked in full **/
+  auto pointer = headerPair(mDecoderPointer, mDecoderDenseEnd);
+  while (pointer < mDecoderDenseEnd && !decoderEventStart(pointer))
+    pointer = headerPair(pointer + 1, mDecoderDenseEnd);
+  long skipped = 4 * (pointer - mDecoderPointer);
+  mDecoderResyncs++;
+  mDecoderResyncBytes += skipped;
+  if (mDecoderVerbose) {
+    printf("%s %08x [ERROR] corrupted data, resync skips %ld bytes \n", colorRed, *mDecoderPointer, skipped);
+  }
+  mDecoderPointer = const_cast<uint32_t *>(pointer);
+  return mDecoderPointer >= mDecoderDenseEnd;
+}
+
 bool
 TOFdecomp::decode()
+{
+  /** the tracing instantiation is only run when a verbose flag is set **/
+  if (mDecoderVerbose || mEncoderVerbose || mCheckerVerbose)
+    return decodeEvent<TracePolicy>();
+  return decodeEvent<FastPolicy>();
+}
+
+inline void
+TOFdecomp::latencyEvent(uint64_t start, uint64_t check)
+{
+  auto decode = TOFlatency::now() - start;
+  (*mLatency)[TOFlatency::kEventDecode].record(decode);
+  (*mLatency)[TOFlatency::kEventSpider].record(mLatencyEventSpider);
+  (*mLatency)[TOFlatency::kEventCheck].record(check);
+  mLatencyPage       += decode;
+  mLatencyPageSpider += mLatencyEventSpider;
+  mLatencyPageCheck  += check;
+}
+
+inline void
+TOFdecomp::latencyPage()
+{
+  (*mLatency)[TOFlatency::kPageDecode].record(mLatencyPage);
+  (*mLatency)[TOFlatency::kPageSpider].record(mLatencyPageSpider);
+  (*mLatency)[TOFlatency::kPageCheck].record(mLatencyPageCheck);
+}
+
+template <typename Policy>
+bool
+TOFdecomp::decodeEvent()
 {
   
   /** check if we have memory to decode **/
-  if ((char *)mDecoderPointer - mDecoderBuffer >= mRawSummary.RDHWord0.MemorySize) {
-#ifdef DECODER_VERBOSE
-    if (mDecoderVerbose) {
+  if (mDecoderPointer >= mDecoderDenseEnd) {
+    if (Policy::Trace && mDecoderVerbose) {
       std::cout << colorYellow
 		<< "-W- decode request exceeds memory size: "
-		<< (void *)mDecoderPointer << " | " << (void *)mDecoderBuffer << " | " << mRawSummary.RDHWord0.MemorySize 
+		<< (void *)mDecoderPointer << " | " << (void *)mDecoderDenseEnd << " | " << mRawSummary.RDHWord0.MemorySize 
  		<< std::endl;
     }
-#endif
+    if (mLatency) latencyPage();
     return true;
   }
 
-#ifdef DECODER_VERBOSE
-  if (mDecoderVerbose) {
+  /** the event time includes a resync in front of it **/
+  uint64_t latencyStart = 0, latencyCheck = 0, latencySpider = 0;
+  if (mLatency) {
+    latencyStart = TOFlatency::now();
+    mLatencyEventSpider = 0;
+  }
+
+  if (Policy::Trace && mDecoderVerbose) {
     std::cout << colorBlue << "--- DECODE EVENT"
 	      << std::endl;    
   }
-#endif
+
+  /** a corrupted event start is skipped up to the next plausible event **/
+  if (!IS_DRM_COMMON_HEADER(mDecoderPointer[0]) || !IS_DRM_GLOBAL_HEADER(mDecoderPointer[2])) {
+    if (decoderResync()) {
+      if (mLatency) {
+	mLatencyPage += TOFlatency::now() - latencyStart;
+	latencyPage();
+      }
+      return true;
+    }
+  }
+
+  /** reserve output, an event cannot encode more than two words per payload word **/
+  encoderReserve(2 * ((char *)mDecoderDenseEnd - (char *)mDecoderPointer) + 64);
+  if (!mEncoderEvent) {
+    mEncoderFull = true;
+    return true;
+  }
 
   /** init decoder **/
-  auto start = std::chrono::high_resolution_clock::now();
-  mDecoderNextWord = 1;
+  TOF_PROBE(eventProbe);
+  TOF_PROBE(drmProbe);
+  TOF_PROBE(chainProbe);
+  TOF_PROBE(trailerProbe);
+  TOF_PROBE_START(eventProbe, mDecoderPointer - mDecoderDense);
+  TOF_PROBE_START(drmProbe, mDecoderPointer - mDecoderDense);
   decoderClear();
     
-  /** check DRM Common Header **/
-  if (!IS_DRM_COMMON_HEADER(*mDecoderPointer)) {
-#ifdef DECODER_VERBOSE
-    printf("%s %08x [ERROR] fatal error \n", colorRed, *mDecoderPointer);
-#endif
-    return true;
-  }
+  /** DRM Common Header **/
   mRawSummary.DRMCommonHeader = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-  if (mDecoderVerbose) {
+  if (Policy::Trace && mDecoderVerbose) {
     auto DRMCommonHeader = reinterpret_cast<raw::DRMCommonHeader_t *>(mDecoderPointer);
     auto Payload = DRMCommonHeader->Payload;
     printf(" %08x DRM Common Header     (Payload=%d) \n", *mDecoderPointer, Payload);
   }
-#endif
   decoderNext32();
 
   /** DRM Orbit Header **/
   mRawSummary.DRMOrbitHeader = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-  if (mDecoderVerbose) {
+  if (Policy::Trace && mDecoderVerbose) {
     auto DRMOrbitHeader = reinterpret_cast<raw::DRMOrbitHeader_t *>(mDecoderPointer);
     auto Orbit = DRMOrbitHeader->Orbit;
     printf(" %08x DRM Orbit Header      (Orbit=%d) \n", *mDecoderPointer, Orbit);
   }
-#endif
   decoderNext32();    
 
-  /** check DRM Global Header **/
-  if (!IS_DRM_GLOBAL_HEADER(*mDecoderPointer)) {
-#ifdef DECODER_VERBOSE
-    printf("%s %08x [ERROR] fatal error \n", colorRed, *mDecoderPointer);
-#endif
-    return true;
-  }
+  /** DRM Global Header **/
   mRawSummary.DRMGlobalHeader = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-  if (mDecoderVerbose) {
+  if (Policy::Trace && mDecoderVerbose) {
     auto DRMGlobalHeader = reinterpret_cast<raw::DRMGlobalHeader_t *>(mDecoderPointer);
     auto DRMID = DRMGlobalHeader->DRMID;
     printf(" %08x DRM Global Header     (DRMID=%d) \n", *mDecoderPointer, DRMID);
   }
-#endif
 #ifdef ALLOW_DRMID
   if (mDRM != -1 && GET_DRMGLOBALHEADER_DRMID(*mDecoderPointer) != mDRM)
     return true;
@@ -378,469 +903,518 @@ TOFdecomp::decode()
 
   /** DRM Status Header 1 **/
   mRawSummary.DRMStatusHeader1 = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-  if (mDecoderVerbose) {
+  if (Policy::Trace && mDecoderVerbose) {
     auto DRMStatusHeader1 = reinterpret_cast<raw::DRMStatusHeader1_t *>(mDecoderPointer);
     auto ParticipatingSlotID = DRMStatusHeader1->ParticipatingSlotID;
     auto CBit = DRMStatusHeader1->CBit;
     auto DRMhSize = DRMStatusHeader1->DRMhSize;
     printf(" %08x DRM Status Header 1   (ParticipatingSlotID=0x%03x, CBit=%d, DRMhSize=%d) \n", *mDecoderPointer, ParticipatingSlotID, CBit, DRMhSize);
   }
-#endif
   decoderNext32();
 
   /** DRM Status Header 2 **/
   mRawSummary.DRMStatusHeader2 = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-  if (mDecoderVerbose) {
+  if (Policy::Trace && mDecoderVerbose) {
     auto DRMStatusHeader2 = reinterpret_cast<raw::DRMStatusHeader2_t *>(mDecoderPointer);
     auto SlotEnableMask = DRMStatusHeader2->SlotEnableMask;
     auto FaultID = DRMStatusHeader2->FaultID;
     auto RTOBit = DRMStatusHeader2->RTOBit;
     printf(" %08x DRM Status Header 2   (SlotEnableMask=0x%03x, FaultID=%d, RTOBit=%d) \n", *mDecoderPointer, SlotEnableMask, FaultID, RTOBit);
   }
-#endif
   decoderNext32();
 
   /** DRM Status Header 3 **/
   mRawSummary.DRMStatusHeader3 = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-  if (mDecoderVerbose) {
+  if (Policy::Trace && mDecoderVerbose) {
     auto DRMStatusHeader3 = reinterpret_cast<raw::DRMStatusHeader3_t *>(mDecoderPointer);
     auto L0BCID = DRMStatusHeader3->L0BCID;
     auto RunTimeInfo = DRMStatusHeader3->RunTimeInfo;
     printf(" %08x DRM Status Header 3   (L0BCID=%d, RunTimeInfo=0x%03x) \n", *mDecoderPointer, L0BCID, RunTimeInfo);
   }
-#endif
   decoderNext32();
 
   /** DRM Status Header 4 **/
   mRawSummary.DRMStatusHeader4 = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-  if (mDecoderVerbose) {
+  if (Policy::Trace && mDecoderVerbose) {
     printf(" %08x DRM Status Header 4 \n", *mDecoderPointer);
   }
-#endif
   decoderNext32();
 
   /** DRM Status Header 5 **/
   mRawSummary.DRMStatusHeader5 = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-  if (mDecoderVerbose) {
+  if (Policy::Trace && mDecoderVerbose) {
     printf(" %08x DRM Status Header 5 \n", *mDecoderPointer);
   }
-#endif
   decoderNext32();
 
+  /** encode Crate Header and Orbit **/
+  encoderCrateHeader<Policy>();
+  TOF_PROBE_STOP(kDRMHeader, drmProbe, mDecoderPointer - mDecoderDense);
+    
+  /**
+   ** threaded dispatch over the DRM payload
+   ** each state jumps straight to the handler of the class of the next
+   ** word, the two TRM chains share one handler
+   **/
+  static void *const drmState[kNWordClasses] = {
+    &&drm_skip, &&drm_skip, &&drm_skip, &&drm_skip,
+    &&drm_header, &&drm_trailer_word, &&drm_skip, &&drm_skip, &&drm_skip
+  };
+  /** after the LTM a second LTM header is not recognised **/
+  static void *const ltmDoneState[kNWordClasses] = {
+    &&drm_skip, &&drm_skip, &&drm_skip, &&drm_skip,
+    &&drm_trm_header, &&drm_trailer_word, &&drm_skip, &&drm_skip, &&drm_skip
+  };
+  static void *const trmState[kNWordClasses] = {
+    &&trm_chain_a, &&trm_skip, &&trm_chain_b, &&trm_skip,
+    &&trm_skip, &&trm_trailer_word, &&trm_skip, &&trm_skip, &&trm_skip
+  };
+  static void *const trmAfterChainAState[kNWordClasses] = {
+    &&trm_skip, &&trm_skip, &&trm_chain_b, &&trm_skip,
+    &&trm_skip, &&trm_trailer_word, &&trm_skip, &&trm_skip, &&trm_skip
+  };
+  static void *const trmAfterChainBState[kNWordClasses] = {
+    &&trm_skip, &&trm_skip, &&trm_skip, &&trm_skip,
+    &&trm_skip, &&trm_trailer_word, &&trm_skip, &&trm_skip, &&trm_skip
+  };
+  static void *const chainState[kNWordClasses] = {
+    &&chain_break, &&chain_trailer, &&chain_break, &&chain_trailer,
+    &&chain_break, &&chain_break, &&chain_error, &&chain_break, &&chain_hit
+  };
+
+  uint32_t SlotID = 0;
+  int itrm = 0, ichain = 0;
+  void *const *chainDoneState = trmAfterChainAState;
+
+ drm_word:
+  DECODER_DISPATCH(drmState);
+
+ drm_header:
+  if (IS_DRM_GLOBAL_HEADER(mDecoderPointer[2]) && decoderEventStart(mDecoderPointer))
+    goto drm_missing_trailer;
+  if (IS_LTM_GLOBAL_HEADER(*mDecoderPointer))
+    goto ltm_header;
+  goto drm_trm_slot;
+ drm_trm_header:
+  if (IS_DRM_GLOBAL_HEADER(mDecoderPointer[2]) && decoderEventStart(mDecoderPointer))
+    goto drm_missing_trailer;
+ drm_trm_slot:
+  /** TRMs sit in slots 3-12, other slots come from corrupted words **/
+  if (GET_TRMGLOBALHEADER_SLOTID(*mDecoderPointer) - 3 < 10)
+    goto trm_header;
+  goto drm_skip;
+
+ drm_trailer_word:
+  if (IS_DRM_GLOBAL_TRAILER(*mDecoderPointer))
+    goto drm_trailer;
+ drm_skip:
+  if (Policy::Trace && mDecoderVerbose) {
+    printf("%s %08x [ERROR] trying to recover DRM decode stream \n", colorRed, *mDecoderPointer);
+  }
+  decoderNext32();
+  goto drm_word;
+
+  /** LTM global header detected **/
+ ltm_header:
+  if (Policy::Trace && mDecoderVerbose) {
+    printf(" %08x LTM Global Header \n", *mDecoderPointer);
+  }
+  decoderNext32();
+
+  /** loop over LTM payload **/
+  while (!IS_LTM_GLOBAL_TRAILER(*mDecoderPointer)) {
+    if (Policy::Trace && mDecoderVerbose) {
+      printf(" %08x LTM data \n", *mDecoderPointer);
+    }
+    decoderNext32();
+  }
+
+  /** LTM global trailer detected **/
+  if (Policy::Trace && mDecoderVerbose) {
+    printf(" %08x LTM Global Trailer \n", *mDecoderPointer);
+  }
+  decoderNext32();
+  DECODER_DISPATCH(ltmDoneState);
+
+  /** TRM global header detected **/
+ trm_header:
+  SlotID = GET_TRMGLOBALHEADER_SLOTID(*mDecoderPointer);
+  itrm = SlotID - 3;
+  decoderClearTRM(itrm);
+  mRawSummary.TRMGlobalHeader[itrm] = *mDecoderPointer;
+  if (Policy::Trace && mDecoderVerbose) {
+    auto TRMGlobalHeader = reinterpret_cast<raw::TRMGlobalHeader_t *>(mDecoderPointer);
+    auto EventWords = TRMGlobalHeader->EventWords;
+    auto EventNumber = TRMGlobalHeader->EventNumber;
+    auto EBit = TRMGlobalHeader->EBit;
+    printf(" %08x TRM Global Header     (SlotID=%d, EventWords=%d, EventNumber=%d, EBit=%01x) \n", *mDecoderPointer, SlotID, EventWords, EventNumber, EBit);
+  }
+  decoderNext32();
+  DECODER_DISPATCH(trmState);
+
+  /** TRM chain-A header detected **/
+ trm_chain_a:
+  if (GET_TRMCHAINHEADER_SLOTID(*mDecoderPointer) != SlotID)
+    goto trm_skip;
+  ichain = 0;
+  chainDoneState = trmAfterChainAState;
+  goto chain_header;
+
+  /** TRM chain-B header detected **/
+ trm_chain_b:
+  if (GET_TRMCHAINHEADER_SLOTID(*mDecoderPointer) != SlotID)
+    goto trm_skip;
+  ichain = 1;
+  chainDoneState = trmAfterChainBState;
+
+  /** TRM chain header, shared by both chains **/
+ chain_header:
+  TOF_PROBE_START(chainProbe, mDecoderPointer - mDecoderDense);
+  mRawSummary.TRMChainHeader[itrm][ichain] = *mDecoderPointer;
+  if (Policy::Trace && mDecoderVerbose) {
+    auto TRMChainHeader = reinterpret_cast<raw::TRMChainHeader_t *>(mDecoderPointer);
+    auto BunchID = TRMChainHeader->BunchID;
+    printf(" %08x TRM Chain-%c Header    (SlotID=%d, BunchID=%d) \n", *mDecoderPointer, 'A' + ichain, SlotID, BunchID);
+  }
+  decoderNext32();
+  DECODER_DISPATCH(chainState);
+
+  /** TDC hit detected, copy the whole run of hits that follows **/
+ chain_hit:
+  {
+    mRawSummary.HasHits[itrm] = true;
+    int nhits = hitRun(mDecoderPointer, mDecoderDenseEnd);
+    auto nTDCHits = mHitSummary->nTDCUnpackedHits[ichain];
+    auto TDCHits = mHitSummary->TDCUnpackedHit[ichain];
+    /** the run starts with the current hit **/
+    do {
+      auto itdc = GET_TDCHIT_TDCID(*mDecoderPointer);
+      TDCHits[itdc][nTDCHits[itdc]++] = *mDecoderPointer;
+      if (Policy::Trace && mDecoderVerbose) {
+	auto TDCUnpackedHit = reinterpret_cast<raw::TDCUnpackedHit_t *>(mDecoderPointer);
+	auto HitTime = TDCUnpackedHit->HitTime;
+	auto Chan = TDCUnpackedHit->Chan;
+	auto TDCID = TDCUnpackedHit->TDCID;
+	auto EBit = TDCUnpackedHit->EBit;
+	auto PSBits = TDCUnpackedHit->PSBits;
+	printf(" %08x TDC Hit               (HitTime=%d, Chan=%d, TDCID=%d, EBit=%d, PSBits=%d \n", *mDecoderPointer, HitTime, Chan, TDCID, EBit, PSBits);
+      }
+      decoderNext32();
+    } while (--nhits > 0);
+  }
+  DECODER_DISPATCH(chainState);
+
+  /** TDC error detected **/
+ chain_error:
+  mRawSummary.HasErrors[itrm][ichain] = true;
+  if (Policy::Trace && mDecoderVerbose) {
+    printf("%s %08x TDC error \n", colorRed, *mDecoderPointer);
+  }
+  decoderNext32();
+  DECODER_DISPATCH(chainState);
+
+  /** TRM chain trailer detected, chain-A trailers only close chain-A **/
+ chain_trailer:
+  if ((*mDecoderPointer >> 28) != (uint32_t)(ichain << 1 | 1))
+    goto chain_break;
+  mRawSummary.TRMChainTrailer[itrm][ichain] = *mDecoderPointer;
+  if (Policy::Trace && mDecoderVerbose) {
+    auto TRMChainTrailer = reinterpret_cast<raw::TRMChainTrailer_t *>(mDecoderPointer);
+    auto EventCounter = TRMChainTrailer->EventCounter;
+    printf(" %08x TRM Chain-%c Trailer   (SlotID=%d, EventCounter=%d) \n", *mDecoderPointer, 'A' + ichain, SlotID, EventCounter);
+  }
+  decoderNext32();
+  TOF_PROBE_STOP(kChain, chainProbe, mDecoderPointer - mDecoderDense);
+  DECODER_DISPATCH(chainDoneState);
+
+ chain_break:
+  if (Policy::Trace && mDecoderVerbose) {
+    printf("%s %08x [ERROR] breaking TRM Chain-%c decode stream \n", colorRed, *mDecoderPointer, 'A' + ichain);
+  }
+  decoderNext32();
+  TOF_PROBE_STOP(kChain, chainProbe, mDecoderPointer - mDecoderDense);
+  DECODER_DISPATCH(chainDoneState);
+
+  /** TRM global trailer detected **/
+ trm_trailer_word:
+  if (!IS_TRM_GLOBAL_TRAILER(*mDecoderPointer))
+    goto trm_skip;
+  mRawSummary.TRMGlobalTrailer[itrm] = *mDecoderPointer;
+  if (Policy::Trace && mDecoderVerbose) {
+    auto TRMGlobalTrailer = reinterpret_cast<raw::TRMGlobalTrailer_t *>(mDecoderPointer);
+    auto EventCRC = TRMGlobalTrailer->EventCRC;
+    auto LBit = TRMGlobalTrailer->LBit;
+    printf(" %08x TRM Global Trailer    (SlotID=%d, EventCRC=%d, LBit=%d) \n", *mDecoderPointer, SlotID, EventCRC, LBit);
+  }
+  decoderNext32();
+
+  /** encoder SPIDER **/
+  if (mRawSummary.HasHits[itrm]) {
+    if (mLatency) latencySpider = TOFlatency::now();
+    spider();
+    if (mLatency) mLatencyEventSpider += TOFlatency::now() - latencySpider;
+    encoderFrames<Policy>(SlotID);
+  }
+
+  /** filler detected **/
+  if (IS_FILLER(*mDecoderPointer)) {
+    if (Policy::Trace && mDecoderVerbose) {
+      printf(" %08x Filler \n", *mDecoderPointer);
+    }
+    decoderNext32();
+  }
+  goto drm_word;
+
+ trm_skip:
+  if (Policy::Trace && mDecoderVerbose) {
+    printf("%s %08x [ERROR] breaking TRM decode stream \n", colorRed, *mDecoderPointer);
+  }
+  decoderNext32();
+  goto drm_word;
+
+  /** DRM global trailer detected **/
+ drm_trailer:
+  mRawSummary.DRMGlobalTrailer = *mDecoderPointer;
+  if (Policy::Trace && mDecoderVerbose) {
+    auto DRMGlobalTrailer = reinterpret_cast<raw::DRMGlobalTrailer_t *>(mDecoderPointer);
+    auto LocalEventCounter = DRMGlobalTrailer->LocalEventCounter;
+    printf(" %08x DRM Global Trailer    (LocalEventCounter=%d) \n", *mDecoderPointer, LocalEventCounter);
+  }
+  decoderNext32();
+
+  /** filler detected **/
+  if (IS_FILLER(*mDecoderPointer)) {
+    if (Policy::Trace && mDecoderVerbose) {
+      printf(" %08x Filler \n", *mDecoderPointer);
+    }
+    decoderNext32();
+  }
+
+  goto drm_event_end;
+
+  /** the next event starts before the DRM trailer, it is decoded by the next call **/
+ drm_missing_trailer:
+  if (Policy::Trace && mDecoderVerbose) {
+    printf("%s %08x [ERROR] DRM Global Trailer missing, next event starts here \n", colorRed, *mDecoderPointer);
+  }
+
+ drm_event_end:
+  /** check event, a crate trailer without check carries no diagnostic words **/
+  if (mLatency) latencyCheck = TOFlatency::now();
+  switch (mCheckLevel) {
+  case kCheckFull:
+    check<Policy, kCheckFull>();
+    break;
+  case kCheckDRM:
+    check<Policy, kCheckDRM>();
+    break;
+  default:
+    break;
+  }
+  if (mLatency) latencyCheck = TOFlatency::now() - latencyCheck;
+
+  /** encode Crate Trailer and Diagnostic Words **/
+  TOF_PROBE_START(trailerProbe, mEncoderPointer - (uint32_t *)mEncoderEvent);
+  encoderCrateTrailer<Policy>();
+  TOF_PROBE_STOP(kTrailer, trailerProbe, mEncoderPointer - (uint32_t *)mEncoderEvent);
+  TOF_PROBE_STOP(kEvent, eventProbe, mDecoderPointer - mDecoderDense);
+    
+  mDecoderByteCounter = 4 * (mDecoderPointer - mDecoderDense);
+  mIntegratedBytes += mDecoderByteCounter;
+  mDecoderEvents++;
+  mEncoderBytes += mEncoderByteCounter;
+  if (mLatency) latencyEvent(latencyStart, latencyCheck);
+    
+  if (Policy::Trace && mDecoderVerbose) {
+    std::cout << colorBlue
+	      << "--- END DECODE EVENT: " << mDecoderByteCounter << " bytes"
+	      << std::endl;
+  }
+
+  return false;
+}
+
+bool
+TOFdecomp::decodePage(const char *page, TOFsegments &output)
+{
+  /** encode straight into the caller segments **/
+  auto segments = mEncoderSegments;
+  mEncoderSegments = &output;
+  mDecoderPage = (char *)page;
+  decoderRewind();
+  decodeRDH();
+  while (!decode())
+    output.commit(mEncoderByteCounter);
+  mEncoderSegments = segments;
+  return false;
+}
+
+bool
+TOFdecomp::decode(const char *data, long size, TOFsink &sink, long *consumed)
+{
+  auto memory = sink.segments();
+  auto output = memory ? memory : &mEncoderSpan;
+  TOFpageWalker walker(data, data + size);
+  const char *decoded = data;
+  bool status = false;
+  mEncoderFull = false;
+  while (!walker.next()) {
+    /** a page is not started unless the sink memory takes its worst case **/
+    if (memory && !memory->reserve(2 * walker.pageSize() + 64))
+      mEncoderFull = true;
+    else
+      decodePage(walker.page(), *output);
+    if (mEncoderFull) {
+      std::cerr << colorRed
+		<< "-E- sink memory full: " << output->size() << " bytes"
+		<< std::endl;
+      status = true;
+      break;
+    }
+    decoded = walker.remainder();
+    if (!memory && output->size() >= mEncoderFlushSize) {
+      std::vector<struct iovec> iov;
+      output->gather(iov);
+      status = sink.write(iov);
+      output->clear();
+      if (status) break;
+    }
+  }
+  if (walker.error()) {
+    std::cerr << colorRed
+	      << "-E- invalid RDH at byte " << walker.remainder() - data << " of the span"
+	      << std::endl;
+    status = true;
+  }
+  if (!memory && !output->empty()) {
+    std::vector<struct iovec> iov;
+    output->gather(iov);
+    if (sink.write(iov)) status = true;
+    output->clear();
+  }
+  if (consumed) *consumed = decoded - data;
+  return status;
+}
+
+template <typename Policy>
+void
+TOFdecomp::encoderCrateHeader()
+{
   /** encode Crate Header **/
   *mEncoderPointer  = 0x80000000;
   *mEncoderPointer |= GET_DRMSTATUSHEADER2_SLOTENABLEMASK(mRawSummary.DRMStatusHeader2) << 12;
   *mEncoderPointer |= GET_DRMGLOBALHEADER_DRMID(mRawSummary.DRMGlobalHeader) << 24;
   *mEncoderPointer |= GET_DRMSTATUSHEADER3_L0BCID(mRawSummary.DRMStatusHeader3);
-#ifdef ENCODER_VERBOSE
-    if (mEncoderVerbose) {
+    if (Policy::Trace && mEncoderVerbose) {
       auto CrateHeader = reinterpret_cast<compressed::CrateHeader_t *>(mEncoderPointer);
       auto BunchID = CrateHeader->BunchID;
       auto DRMID = CrateHeader->DRMID;
       auto SlotEnableMask = CrateHeader->SlotEnableMask;
       printf("%s %08x Crate header          (DRMID=%d, BunchID=%d, SlotEnableMask=0x%x) \n", colorGreen, *mEncoderPointer, DRMID, BunchID, SlotEnableMask);
     }
-#endif
   encoderNext32();
     
   /** encode Crate Orbit **/
   *mEncoderPointer = mRawSummary.DRMOrbitHeader;
-#ifdef ENCODER_VERBOSE
-    if (mEncoderVerbose) {
+    if (Policy::Trace && mEncoderVerbose) {
       auto CrateOrbit = reinterpret_cast<compressed::CrateOrbit_t *>(mEncoderPointer);
       auto OrbitID = CrateOrbit->OrbitID;
       printf("%s %08x Crate orbit           (OrbitID=%d) \n", colorGreen, *mEncoderPointer, OrbitID);
     }
-#endif
-    encoderNext32();
-    
-  /** loop over DRM payload **/
-  while (true) {
-
-    /** LTM global header detected **/
-    if (IS_LTM_GLOBAL_HEADER(*mDecoderPointer)) {
-	
-#ifdef DECODER_VERBOSE
-      if (mDecoderVerbose) {
-	printf(" %08x LTM Global Header \n", *mDecoderPointer);
-      }
-#endif
-      decoderNext32();
-
-      /** loop over LTM payload **/
-      while (true) {
-
-	/** LTM global trailer detected **/
-	if (IS_LTM_GLOBAL_TRAILER(*mDecoderPointer)) {
-#ifdef DECODER_VERBOSE
-	  if (mDecoderVerbose) {
-	    printf(" %08x LTM Global Trailer \n", *mDecoderPointer);
-	  }
-#endif
-	  decoderNext32();
-	  break;
-	}
-
-#ifdef DECODER_VERBOSE
-	if (mDecoderVerbose) {
-	  printf(" %08x LTM data \n", *mDecoderPointer);
-	}
-#endif
-	decoderNext32();
-      }
-	
-    }
-      
-    /** TRM global header detected **/
-    if (IS_TRM_GLOBAL_HEADER(*mDecoderPointer) && GET_TRMGLOBALHEADER_SLOTID(*mDecoderPointer) > 2) {
-      uint32_t SlotID = GET_TRMGLOBALHEADER_SLOTID(*mDecoderPointer);
-      int itrm = SlotID - 3;
-      mRawSummary.TRMGlobalHeader[itrm] = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-      if (mDecoderVerbose) {
-	auto TRMGlobalHeader = reinterpret_cast<raw::TRMGlobalHeader_t *>(mDecoderPointer);
-	auto EventWords = TRMGlobalHeader->EventWords;
-	auto EventNumber = TRMGlobalHeader->EventNumber;
-	auto EBit = TRMGlobalHeader->EBit;
-	printf(" %08x TRM Global Header     (SlotID=%d, EventWords=%d, EventNumber=%d, EBit=%01x) \n", *mDecoderPointer, SlotID, EventWords, EventNumber, EBit);
-      }
-#endif
-      decoderNext32();
-	
-      /** loop over TRM payload **/
-      while (true) {
-
-	/** TRM chain-A header detected **/
-	if (IS_TRM_CHAINA_HEADER(*mDecoderPointer) && GET_TRMCHAINHEADER_SLOTID(*mDecoderPointer) == SlotID) {
-	  int ichain = 0;
-	  mRawSummary.TRMChainHeader[itrm][ichain] = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-	  if (mDecoderVerbose) {
-	    auto TRMChainHeader = reinterpret_cast<raw::TRMChainHeader_t *>(mDecoderPointer);
-	    auto BunchID = TRMChainHeader->BunchID;
-	    printf(" %08x TRM Chain-A Header    (SlotID=%d, BunchID=%d) \n", *mDecoderPointer, SlotID, BunchID);
-	  }
-#endif
-	  decoderNext32();
-
-	  /** loop over TRM chain-A payload **/
-	  while (true) {
-	      
-	    /** TDC hit detected **/
-	    if (IS_TDC_HIT(*mDecoderPointer)) {
-	      mRawSummary.HasHits[itrm] = true;
-	      auto itdc = GET_TDCHIT_TDCID(*mDecoderPointer);
-	      auto ihit = mRawSummary.nTDCUnpackedHits[ichain][itdc];
-	      mRawSummary.TDCUnpackedHit[ichain][itdc][ihit] = *mDecoderPointer;
-	      mRawSummary.nTDCUnpackedHits[ichain][itdc]++;
-#ifdef DECODER_VERBOSE
-	      if (mDecoderVerbose) {
-		auto TDCUnpackedHit = reinterpret_cast<raw::TDCUnpackedHit_t *>(mDecoderPointer);
-		auto HitTime = TDCUnpackedHit->HitTime;
-		auto Chan = TDCUnpackedHit->Chan;
-		auto TDCID = TDCUnpackedHit->TDCID;
-		auto EBit = TDCUnpackedHit->EBit;
-		auto PSBits = TDCUnpackedHit->PSBits;
-		printf(" %08x TDC Hit               (HitTime=%d, Chan=%d, TDCID=%d, EBit=%d, PSBits=%d \n", *mDecoderPointer, HitTime, Chan, TDCID, EBit, PSBits);
-	      }
-#endif
-	      decoderNext32();
-	      continue;
-	    }
-	      
-	    /** TDC error detected **/
-	    if (IS_TDC_ERROR(*mDecoderPointer)) {
-	      mRawSummary.HasErrors[itrm][ichain] = true;
-#ifdef DECODER_VERBOSE
-	      if (mDecoderVerbose) {
-		printf("%s %08x TDC error \n", colorRed, *mDecoderPointer);
-	      }
-#endif
-	      decoderNext32();
-	      continue;
-	    }
-	      
-	    /** TRM chain-A trailer detected **/
-	    if (IS_TRM_CHAINA_TRAILER(*mDecoderPointer)) {
-	      mRawSummary.TRMChainTrailer[itrm][ichain] = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-	      if (mDecoderVerbose) {
-		auto TRMChainTrailer = reinterpret_cast<raw::TRMChainTrailer_t *>(mDecoderPointer);
-		auto EventCounter = TRMChainTrailer->EventCounter;
-		printf(" %08x TRM Chain-A Trailer   (SlotID=%d, EventCounter=%d) \n", *mDecoderPointer, SlotID, EventCounter);
-	      }
-#endif
-	      decoderNext32();
-	      break;
-	    }
-	      
-#ifdef DECODER_VERBOSE
-	    if (mDecoderVerbose) {
-	      printf("%s %08x [ERROR] breaking TRM Chain-A decode stream \n", colorRed, *mDecoderPointer);
-	    }
-#endif
-	    decoderNext32();
-	    break;
-	      
-	  }} /** end of loop over TRM chain-A payload **/	    
-	  
-	/** TRM chain-B header detected **/
-	if (IS_TRM_CHAINB_HEADER(*mDecoderPointer) && GET_TRMCHAINHEADER_SLOTID(*mDecoderPointer) == SlotID) {
-	  int ichain = 1;
-	  mRawSummary.TRMChainHeader[itrm][ichain] = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-	  if (mDecoderVerbose) {
-	    auto TRMChainHeader = reinterpret_cast<raw::TRMChainHeader_t *>(mDecoderPointer);
-	    auto BunchID = TRMChainHeader->BunchID;
-	    printf(" %08x TRM Chain-B Header    (SlotID=%d, BunchID=%d) \n", *mDecoderPointer, SlotID, BunchID);
-	  }
-#endif
-	  decoderNext32();
-	    
-	  /** loop over TRM chain-B payload **/
-	  while (true) {
-	      
-	    /** TDC hit detected **/
-	    if (IS_TDC_HIT(*mDecoderPointer)) {
-	      mRawSummary.HasHits[itrm] = true;
-	      auto itdc = GET_TDCHIT_TDCID(*mDecoderPointer);
-	      auto ihit = mRawSummary.nTDCUnpackedHits[ichain][itdc];
-	      mRawSummary.TDCUnpackedHit[ichain][itdc][ihit] = *mDecoderPointer;
-	      mRawSummary.nTDCUnpackedHits[ichain][itdc]++;
-#ifdef DECODER_VERBOSE
-	      if (mDecoderVerbose) {
-		auto TDCUnpackedHit = reinterpret_cast<raw::TDCUnpackedHit_t *>(mDecoderPointer);
-		auto HitTime = TDCUnpackedHit->HitTime;
-		auto Chan = TDCUnpackedHit->Chan;
-		auto TDCID = TDCUnpackedHit->TDCID;
-		auto EBit = TDCUnpackedHit->EBit;
-		auto PSBits = TDCUnpackedHit->PSBits;
-		printf(" %08x TDC Hit               (HitTime=%d, Chan=%d, TDCID=%d, EBit=%d, PSBits=%d \n", *mDecoderPointer, HitTime, Chan, TDCID, EBit, PSBits);
-	      }
-#endif
-	      decoderNext32();
-	      continue;
-	    }
-	      
-	    /** TDC error detected **/
-	    if (IS_TDC_ERROR(*mDecoderPointer)) {
-	      mRawSummary.HasErrors[itrm][ichain] = true;
-#ifdef DECODER_VERBOSE
-	      if (mDecoderVerbose) {
-		printf("%s %08x TDC error \n", colorRed, *mDecoderPointer);
-	      }
-#endif
-	      decoderNext32();
-	      continue;
-	    }
-	      
-	    /** TRM chain-B trailer detected **/
-	    if (IS_TRM_CHAINB_TRAILER(*mDecoderPointer)) {
-	      mRawSummary.TRMChainTrailer[itrm][ichain] = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-	      if (mDecoderVerbose) {
-		auto TRMChainTrailer = reinterpret_cast<raw::TRMChainTrailer_t *>(mDecoderPointer);
-		auto EventCounter = TRMChainTrailer->EventCounter;
-		printf(" %08x TRM Chain-B Trailer   (SlotID=%d, EventCounter=%d) \n", *mDecoderPointer, SlotID, EventCounter);
-	      }
-#endif
-	      decoderNext32();
-	      break;
-	    }
-	      
-#ifdef DECODER_VERBOSE
-	    if (mDecoderVerbose) {
-	      printf("%s %08x [ERROR] breaking TRM Chain-B decode stream \n", colorRed, *mDecoderPointer);
-	    }
-#endif
-	    decoderNext32();
-	    break;
-	      
-	  }} /** end of loop over TRM chain-A payload **/	    
-	  
-	/** TRM global trailer detected **/
-	if (IS_TRM_GLOBAL_TRAILER(*mDecoderPointer)) {
-	  mRawSummary.TRMGlobalTrailer[itrm] = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-	  if (mDecoderVerbose) {
-	    auto TRMGlobalTrailer = reinterpret_cast<raw::TRMGlobalTrailer_t *>(mDecoderPointer);
-	    auto EventCRC = TRMGlobalTrailer->EventCRC;
-	    auto LBit = TRMGlobalTrailer->LBit;
-	    printf(" %08x TRM Global Trailer    (SlotID=%d, EventCRC=%d, LBit=%d) \n", *mDecoderPointer, SlotID, EventCRC, LBit);
-	  }
-#endif
-	  decoderNext32();
-
-	  /** encoder SPIDER **/
-	  if (mRawSummary.HasHits[itrm]) {
-
-	    spider();
-	    
-	    /** loop over frames **/
-	    for (int iframe = mRawSummary.FirstFilledFrame; iframe < mRawSummary.LastFilledFrame + 1; iframe++) {
-		
-	      /** check if frame is empty **/
-	      if (mRawSummary.nFramePackedHits[iframe] == 0)
-		continue;
-		
-	      // encode Frame Header
-	      *mEncoderPointer  = 0x00000000;
-	      *mEncoderPointer |= SlotID << 24;
-	      *mEncoderPointer |= iframe << 16;
-	      *mEncoderPointer |= mRawSummary.nFramePackedHits[iframe];
-#ifdef ENCODER_VERBOSE
-	      if (mEncoderVerbose) {
-		auto FrameHeader = reinterpret_cast<compressed::FrameHeader_t *>(mEncoderPointer);
-		auto NumberOfHits = FrameHeader->NumberOfHits;
-		auto FrameID = FrameHeader->FrameID;
-		auto TRMID = FrameHeader->TRMID;
-		printf("%s %08x Frame header          (TRMID=%d, FrameID=%d, NumberOfHits=%d) \n", colorGreen, *mEncoderPointer, TRMID, FrameID, NumberOfHits);
-	      }
-#endif
-	      encoderNext32();
-	      
-	      // packed hits
-	      for (int ihit = 0; ihit < mRawSummary.nFramePackedHits[iframe]; ++ihit) {
-		*mEncoderPointer = mRawSummary.FramePackedHit[iframe][ihit];
-#ifdef ENCODER_VERBOSE
-		if (mEncoderVerbose) {
-		  auto PackedHit = reinterpret_cast<compressed::PackedHit_t *>(mEncoderPointer);
-		  auto Chain = PackedHit->Chain;
-		  auto TDCID = PackedHit->TDCID;
-		  auto Channel = PackedHit->Channel;
-		  auto Time = PackedHit->Time;
-		  auto TOT = PackedHit->TOT;
-		  printf("%s %08x Packed hit            (Chain=%d, TDCID=%d, Channel=%d, Time=%d, TOT=%d) \n", colorGreen, *mEncoderPointer, Chain, TDCID, Channel, Time, TOT);
-		}
-#endif
-		encoderNext32();
-	      }
-	      
-	      mRawSummary.nFramePackedHits[iframe] = 0;
-	    }
-	  }
-	    
-	  /** filler detected **/
-	  if (IS_FILLER(*mDecoderPointer)) {
-#ifdef DECODER_VERBOSE
-	    if (mDecoderVerbose) {
-	      printf(" %08x Filler \n", *mDecoderPointer);
-	    }
-#endif
-	    decoderNext32();
-	  }
-	    
-	  break;
-	}
-	  
-#ifdef DECODER_VERBOSE
-	if (mDecoderVerbose) {
-	  printf("%s %08x [ERROR] breaking TRM decode stream \n", colorRed, *mDecoderPointer);
-	}
-#endif
-	decoderNext32();
-	break;
-	  
-      } /** end of loop over TRM payload **/
-	
-      continue;
-    }
-      
-    /** DRM global trailer detected **/
-    if (IS_DRM_GLOBAL_TRAILER(*mDecoderPointer)) {
-      mRawSummary.DRMGlobalTrailer = *mDecoderPointer;
-#ifdef DECODER_VERBOSE
-      if (mDecoderVerbose) {
-	auto DRMGlobalTrailer = reinterpret_cast<raw::DRMGlobalTrailer_t *>(mDecoderPointer);
-	auto LocalEventCounter = DRMGlobalTrailer->LocalEventCounter;
-	printf(" %08x DRM Global Trailer    (LocalEventCounter=%d) \n", *mDecoderPointer, LocalEventCounter);
-      }
-#endif
-      decoderNext32();
-
-      /** filler detected **/
-      if (IS_FILLER(*mDecoderPointer)) {
-#ifdef DECODER_VERBOSE
-	if (mDecoderVerbose) {
-	  printf(" %08x Filler \n", *mDecoderPointer);
-	}
-#endif
-	decoderNext32();
-      }
+  encoderNext32();
+}
 
-      /** check event **/
-      check();
-
-      /** encode Crate Trailer **/
-      *mEncoderPointer  = 0x80000000;
-      *mEncoderPointer |= mRawSummary.nDiagnosticWords;
-      *mEncoderPointer |= GET_DRMGLOBALTRAILER_LOCALEVENTCOUNTER(mRawSummary.DRMGlobalTrailer) << 4;
-#ifdef ENCODER_VERBOSE
-      if (mEncoderVerbose) {
-	auto CrateTrailer = reinterpret_cast<compressed::CrateTrailer_t *>(mEncoderPointer);
-	auto EventCounter = CrateTrailer->EventCounter;
-	auto NumberOfDiagnostics = CrateTrailer->NumberOfDiagnostics;
-	printf("%s %08x Crate trailer         (EventCounter=%d, NumberOfDiagnostics=%d) \n", colorGreen, *mEncoderPointer, EventCounter, NumberOfDiagnostics);
+template <typename Policy>
+void
+TOFdecomp::encoderFrames(uint32_t SlotID)
+{
+  TOF_PROBE(probe);
+  TOF_PROBE_START(probe, mEncoderPointer - (uint32_t *)mEncoderEvent);
+
+  /** loop over the filled frames **/
+  for (int iword = 0; iword < 4; ++iword)
+    for (auto mask = mHitSummary->FilledFrames[iword]; mask; mask &= mask - 1) {
+      auto iframe = iword * 64 + __builtin_ctzll(mask);
+      auto nhits = mHitSummary->nFramePackedHits[iframe];
+      auto hits = &mHitSummary->FramePackedHit[mHitSummary->FrameOffset[iframe]];
+
+      // encode Frame Header
+      *mEncoderPointer  = 0x00000000;
+      *mEncoderPointer |= SlotID << 24;
+      *mEncoderPointer |= iframe << 16;
+      *mEncoderPointer |= nhits;
+      if (Policy::Trace && mEncoderVerbose) {
+	auto FrameHeader = reinterpret_cast<compressed::FrameHeader_t *>(mEncoderPointer);
+	auto NumberOfHits = FrameHeader->NumberOfHits;
+	auto FrameID = FrameHeader->FrameID;
+	auto TRMID = FrameHeader->TRMID;
+	printf("%s %08x Frame header          (TRMID=%d, FrameID=%d, NumberOfHits=%d) \n", colorGreen, *mEncoderPointer, TRMID, FrameID, NumberOfHits);
       }
-#endif
       encoderNext32();
 
-      /** encode Diagnostic Words **/
-      for (int iword = 0; iword < mRawSummary.nDiagnosticWords; ++iword) {
-	*mEncoderPointer = mRawSummary.DiagnosticWord[iword];
-#ifdef ENCODER_VERBOSE
-	if (mEncoderVerbose) {
-	  auto Diagnostic = reinterpret_cast<compressed::Diagnostic_t *>(mEncoderPointer);
-	  auto SlotID = Diagnostic->SlotID;
-	  auto FaultBits = Diagnostic->FaultBits;
-	  printf("%s %08x Diagnostic            (SlotID=%d, FaultBits=0x%x) \n", colorGreen, *mEncoderPointer, SlotID, FaultBits);
+      // packed hits
+      for (int ihit = 0; ihit < nhits; ++ihit) {
+	*mEncoderPointer = hits[ihit];
+	if (Policy::Trace && mEncoderVerbose) {
+	  auto PackedHit = reinterpret_cast<compressed::PackedHit_t *>(mEncoderPointer);
+	  auto Chain = PackedHit->Chain;
+	  auto TDCID = PackedHit->TDCID;
+	  auto Channel = PackedHit->Channel;
+	  auto Time = PackedHit->Time;
+	  auto TOT = PackedHit->TOT;
+	  printf("%s %08x Packed hit            (Chain=%d, TDCID=%d, Channel=%d, Time=%d, TOT=%d) \n", colorGreen, *mEncoderPointer, Chain, TDCID, Channel, Time, TOT);
 	}
-#endif
 	encoderNext32();
       }
+    }
 
-      mRawSummary.nDiagnosticWords = 0;
+  TOF_PROBE_STOP(kFrames, probe, mEncoderPointer - (uint32_t *)mEncoderEvent);
+}
 
-      break;
-    }
-      
-#ifdef DECODER_VERBOSE
-    if (mDecoderVerbose) {
-      printf("%s %08x [ERROR] trying to recover DRM decode stream \n", colorRed, *mDecoderPointer);
+template <typename Policy>
+void
+TOFdecomp::encoderCrateTrailer()
+{
+  /** encode Crate Trailer **/
+  *mEncoderPointer  = 0x80000000;
+  *mEncoderPointer |= mRawSummary.nDiagnosticWords;
+  *mEncoderPointer |= GET_DRMGLOBALTRAILER_LOCALEVENTCOUNTER(mRawSummary.DRMGlobalTrailer) << 4;
+  if (Policy::Trace && mEncoderVerbose) {
+    auto CrateTrailer = reinterpret_cast<compressed::CrateTrailer_t *>(mEncoderPointer);
+    auto EventCounter = CrateTrailer->EventCounter;
+    auto NumberOfDiagnostics = CrateTrailer->NumberOfDiagnostics;
+    printf("%s %08x Crate trailer         (EventCounter=%d, NumberOfDiagnostics=%d) \n", colorGreen, *mEncoderPointer, EventCounter, NumberOfDiagnostics);
+  }
+  encoderNext32();
+
+  /** encode Diagnostic Words **/
+  for (int iword = 0; iword < mRawSummary.nDiagnosticWords; ++iword) {
+    *mEncoderPointer = mRawSummary.DiagnosticWord[iword];
+    if (Policy::Trace && mEncoderVerbose) {
+      auto Diagnostic = reinterpret_cast<compressed::Diagnostic_t *>(mEncoderPointer);
+      auto SlotID = Diagnostic->SlotID;
+      auto FaultBits = Diagnostic->FaultBits;
+      printf("%s %08x Diagnostic            (SlotID=%d, FaultBits=0x%x) \n", colorGreen, *mEncoderPointer, SlotID, FaultBits);
     }
-#endif
-    decoderNext32();
-      
-  } /** end of loop over DRM payload **/
-    
-  auto finish = std::chrono::high_resolution_clock::now();
-  std::chrono::duration<double> elapsed = finish - start;
-    
-  mIntegratedBytes += mDecoderByteCounter;
-  mIntegratedTime += elapsed.count();
-    
-#ifdef DECODER_VERBOSE
-  if (mDecoderVerbose) {
-    std::cout << colorBlue
-	      << "--- END DECODE EVENT: " << mDecoderByteCounter << " bytes"
-	      << std::endl;
+    encoderNext32();
   }
-#endif
 
-  return false;
+  mRawSummary.nDiagnosticWords = 0;
 }
 
 void
 TOFdecomp::spider()
 {
-  /** reset packed hits counter **/
-  mRawSummary.FirstFilledFrame = 255;
-  mRawSummary.LastFilledFrame = 0;
+  TOF_PROBE(probe);
+  TOF_PROBE_START(probe, 0);
+
+  /** clear the frames filled by the previous TRM **/
+  for (int iword = 0; iword < 4; ++iword) {
+    for (auto mask = mHitSummary->FilledFrames[iword]; mask; mask &= mask - 1)
+      mHitSummary->nFramePackedHits[iword * 64 + __builtin_ctzll(mask)] = 0;
+    mHitSummary->FilledFrames[iword] = 0;
+  }
+  mHitSummary->nPackedHits = 0;
   
   /** loop over TRM chains **/
   for (int ichain = 0; ichain < 2; ++ichain) {
@@ -848,56 +1422,76 @@ TOFdecomp::spider()
     /** loop over TDCs **/
     for (int itdc = 0; itdc < 15; ++itdc) {
       
-      auto nhits = mRawSummary.nTDCUnpackedHits[ichain][itdc];
+      auto nhits = mHitSummary->nTDCUnpackedHits[ichain][itdc];
       if (nhits == 0)
 	continue;
       
+      /**
+       ** single pass over the hits, a leading hit is packed right away
+       ** and stays open on its channel until a trailing hit of the same
+       ** channel closes it with the TOT; a later leading hit replaces
+       ** the open one, trailing hits with no open leading are dropped
+       **/
+      uint32_t *open[8] = {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+      uint32_t openTime[8];
+      
       /** loop over hits **/
       for (int ihit = 0; ihit < nhits; ++ihit) {
 	
-	auto lhit = mRawSummary.TDCUnpackedHit[ichain][itdc][ihit];
-	if (GET_TDCHIT_PSBITS(lhit) != 0x1)
-	  continue; // must be a leading hit
-	
-	auto Chan    = GET_TDCHIT_CHAN(lhit);
-	auto HitTime = GET_TDCHIT_HITTIME(lhit);
-	auto EBit    = GET_TDCHIT_EBIT(lhit);
-	uint32_t TOTWidth = 0;
+	auto hit = mHitSummary->TDCUnpackedHit[ichain][itdc][ihit];
+	auto PSBits  = GET_TDCHIT_PSBITS(hit);
+	auto Chan    = GET_TDCHIT_CHAN(hit);
+	auto HitTime = GET_TDCHIT_HITTIME(hit);
 	
-	// check next hits for packing
-	for (int jhit = ihit + 1; jhit < nhits; ++jhit) {
-	  auto thit = mRawSummary.TDCUnpackedHit[ichain][itdc][jhit];
-	  if (GET_TDCHIT_PSBITS(thit) == 0x2 && GET_TDCHIT_CHAN(thit) == Chan) { // must be a trailing hit from same channel
-	    TOTWidth = GET_TDCHIT_HITTIME(thit) - HitTime; // compute TOT
-	    lhit = 0x0; // mark as used
-	    break;
+	if (PSBits == 0x2) { // trailing hit, closes the open leading hit
+	  if (open[Chan]) {
+	    *open[Chan] |= ((HitTime - openTime[Chan]) & 0x7FF) << 0; // TOT
+	    open[Chan] = nullptr;
 	  }
+	  continue;
 	}
+	if (PSBits != 0x1)
+	  continue; // must be a leading hit
 	
+	/** pack the hit and count it in its frame **/
 	auto iframe = HitTime >> 13;
-	auto phit = mRawSummary.nFramePackedHits[iframe];
-	
-	mRawSummary.FramePackedHit[iframe][phit]  = 0x00000000;
-	mRawSummary.FramePackedHit[iframe][phit] |= (TOTWidth & 0x7FF) <<  0;
-	mRawSummary.FramePackedHit[iframe][phit] |= (HitTime  & 0x1FFF) << 11;
-	mRawSummary.FramePackedHit[iframe][phit] |= Chan << 24;
-	mRawSummary.FramePackedHit[iframe][phit] |= itdc << 27;
-	mRawSummary.FramePackedHit[iframe][phit] |= ichain << 31;
-	mRawSummary.nFramePackedHits[iframe]++;
+	auto phit = mHitSummary->nPackedHits++;
 	
-	if (iframe < mRawSummary.FirstFilledFrame)
-	  mRawSummary.FirstFilledFrame = iframe;
-	if (iframe > mRawSummary.LastFilledFrame)
-	  mRawSummary.LastFilledFrame = iframe;
+	mHitSummary->PackedHit[phit]  = 0x00000000;
+	mHitSummary->PackedHit[phit] |= (HitTime  & 0x1FFF) << 11;
+	mHitSummary->PackedHit[phit] |= Chan << 24;
+	mHitSummary->PackedHit[phit] |= itdc << 27;
+	mHitSummary->PackedHit[phit] |= ichain << 31;
+	mHitSummary->PackedHitFrame[phit] = iframe;
+	mHitSummary->nFramePackedHits[iframe]++;
+	mHitSummary->FilledFrames[iframe >> 6] |= 1ull << (iframe & 63);
+	open[Chan] = &mHitSummary->PackedHit[phit];
+	openTime[Chan] = HitTime;
 	
       }
       
-      mRawSummary.nTDCUnpackedHits[ichain][itdc] = 0;
+      mHitSummary->nTDCUnpackedHits[ichain][itdc] = 0;
     }
   }
   
+  /** prefix sum over the filled frames **/
+  uint16_t cursor[256];
+  uint16_t offset = 0;
+  for (int iword = 0; iword < 4; ++iword)
+    for (auto mask = mHitSummary->FilledFrames[iword]; mask; mask &= mask - 1) {
+      auto iframe = iword * 64 + __builtin_ctzll(mask);
+      mHitSummary->FrameOffset[iframe] = cursor[iframe] = offset;
+      offset += mHitSummary->nFramePackedHits[iframe];
+    }
+  
+  /** place the hits in their frame, in spider order within a frame **/
+  for (uint32_t phit = 0; phit < mHitSummary->nPackedHits; ++phit)
+    mHitSummary->FramePackedHit[cursor[mHitSummary->PackedHitFrame[phit]]++] = mHitSummary->PackedHit[phit];
+  
+  TOF_PROBE_STOP(kSpider, probe, mHitSummary->nPackedHits);
 }
 
+template <typename Policy, int Level>
 bool
 TOFdecomp::check()
 {
@@ -907,15 +1501,14 @@ TOFdecomp::check()
   //  mRawSummary.CheckStatus = false;
   mCounter++;
   
-  auto start = std::chrono::high_resolution_clock::now();
+  TOF_PROBE(probe);
+  TOF_PROBE_START(probe, 0);
    
-#ifdef CHECKER_VERBOSE
-    if (mCheckerVerbose) {
+    if (Policy::Trace && mCheckerVerbose) {
       std::cout << colorBlue
 		<< "--- CHECK EVENT"
 		<< std::endl;    
     }
-#endif
 
     /** increment check counter **/
     //    mCheckerCounter++;
@@ -926,11 +1519,9 @@ TOFdecomp::check()
       mRawSummary.faultFlags |= 1;
       mRawSummary.DiagnosticWord[0] |= DIAGNOSTIC_DRM_HEADER;
       mRawSummary.nDiagnosticWords++;
-#ifdef CHECKER_VERBOSE
-      if (mCheckerVerbose) {
+      if (Policy::Trace && mCheckerVerbose) {
 	printf(" Missing DRM Global Header \n");
       }
-#endif
       return status;
     }
     
@@ -940,11 +1531,9 @@ TOFdecomp::check()
       mRawSummary.faultFlags |= 1;
       mRawSummary.DiagnosticWord[0] |= DIAGNOSTIC_DRM_TRAILER;
       mRawSummary.nDiagnosticWords++;
-#ifdef CHECKER_VERBOSE
-      if (mCheckerVerbose) {
+      if (Policy::Trace && mCheckerVerbose) {
 	printf(" Missing DRM Global Trailer \n");
       }
-#endif
       return status;
     }
 
@@ -958,11 +1547,9 @@ TOFdecomp::check()
     uint32_t LocalEventCounter   = GET_DRMGLOBALTRAILER_LOCALEVENTCOUNTER(mRawSummary.DRMGlobalTrailer);
 
     if (ParticipatingSlotID != SlotEnableMask) {
-#ifdef CHECKER_VERBOSE
-      if (mCheckerVerbose) {
+      if (Policy::Trace && mCheckerVerbose) {
 	printf(" Warning: enable/participating mask differ: %03x/%03x \n", SlotEnableMask, ParticipatingSlotID);
       }
-#endif
       mRawSummary.DiagnosticWord[0] |= DIAGNOSTIC_DRM_ENABLEMASK;
     }
     
@@ -972,11 +1559,9 @@ TOFdecomp::check()
       mRawSummary.faultFlags |= 1;
       mDRMCounters.CBit++;
       mRawSummary.DiagnosticWord[0] |= DIAGNOSTIC_DRM_CBIT;
-#ifdef CHECKER_VERBOSE
-      if (mCheckerVerbose) {
+      if (Policy::Trace && mCheckerVerbose) {
 	printf(" DRM CBit is on \n");
       }
-#endif	
     }
       
     /** check DRM FaultID **/
@@ -985,11 +1570,9 @@ TOFdecomp::check()
       mRawSummary.faultFlags |= 1;
       mDRMCounters.Fault++;
       mRawSummary.DiagnosticWord[0] |= DIAGNOSTIC_DRM_FAULTID;
-#ifdef CHECKER_VERBOSE
-      if (mCheckerVerbose) {
+      if (Policy::Trace && mCheckerVerbose) {
 	printf(" DRM FaultID: %x \n", GET_DRMSTATUSHEADER2_FAULTID(mRawSummary.DRMStatusHeader2));
       }
-#endif	
     }
       
     /** check DRM RTOBit **/
@@ -998,17 +1581,17 @@ TOFdecomp::check()
       mRawSummary.faultFlags |= 1;
       mDRMCounters.RTOBit++;
       mRawSummary.DiagnosticWord[0] |= DIAGNOSTIC_DRM_RTOBIT;
-#ifdef CHECKER_VERBOSE
-      if (mCheckerVerbose) {
+      if (Policy::Trace && mCheckerVerbose) {
 	printf(" DRM RTOBit is on \n");
       }
-#endif	
     }
 
-    /** loop over TRMs **/
-    for (int itrm = 0; itrm < 10; ++itrm) {
+    /** loop over TRMs, not at the DRM-only level **/
+    for (int itrm = 0; Level == kCheckFull && itrm < 10; ++itrm) {
       uint32_t SlotID = itrm + 3;
       uint32_t trmFaultBit = 1 << (1 + itrm * 3);
+      /** TRM fields of a past generation were not seen in this event **/
+      uint32_t TRMGlobalHeader = mRawSummary.TRMGeneration[itrm] == mRawSummary.Generation ? mRawSummary.TRMGlobalHeader[itrm] : 0x0;
 
       /** check current diagnostic word **/
       auto iword = mRawSummary.nDiagnosticWords;
@@ -1022,29 +1605,25 @@ TOFdecomp::check()
       
       /** check participating TRM **/
       if (!(ParticipatingSlotID & 1 << (itrm + 1))) {
-	if (mRawSummary.TRMGlobalHeader[itrm] != 0x0) {
+	if (TRMGlobalHeader != 0x0) {
 	  status = true;
 	  mRawSummary.DiagnosticWord[iword] |= DIAGNOSTIC_TRM_UNEXPECTED;
-#ifdef CHECKER_VERBOSE
-	  if (mCheckerVerbose) {
+	  if (Policy::Trace && mCheckerVerbose) {
 	    printf(" Non-participating header found (SlotID=%d) \n", SlotID);	
 	  }
-#endif
 	}
 	mRawSummary.faultFlags |= trmFaultBit;
        	continue;
       }
       
       /** check TRM Global Header **/
-      if (mRawSummary.TRMGlobalHeader[itrm] == 0x0) {
+      if (TRMGlobalHeader == 0x0) {
 	status = true;
 	mRawSummary.faultFlags |= trmFaultBit;
 	mRawSummary.DiagnosticWord[iword] |= DIAGNOSTIC_TRM_HEADER;
-#ifdef CHECKER_VERBOSE
-	if (mCheckerVerbose) {
+	if (Policy::Trace && mCheckerVerbose) {
 	  printf(" Missing TRM Header (SlotID=%d) \n", SlotID);
 	}
-#endif
 	continue;
       }
 
@@ -1053,11 +1632,9 @@ TOFdecomp::check()
 	status = true;
 	mRawSummary.faultFlags |= trmFaultBit;
 	mRawSummary.DiagnosticWord[iword] |= DIAGNOSTIC_TRM_TRAILER;
-#ifdef CHECKER_VERBOSE
-	if (mCheckerVerbose) {
+	if (Policy::Trace && mCheckerVerbose) {
 	  printf(" Missing TRM Trailer (SlotID=%d) \n", SlotID);
 	}
-#endif
 	continue;
       }
 
@@ -1069,31 +1646,27 @@ TOFdecomp::check()
 	mTRMCounters[itrm].Empty++;
       
       /** check TRM EventCounter **/
-      uint32_t EventCounter = GET_TRMGLOBALHEADER_EVENTNUMBER(mRawSummary.TRMGlobalHeader[itrm]);
+      uint32_t EventCounter = GET_TRMGLOBALHEADER_EVENTNUMBER(TRMGlobalHeader);
       if (EventCounter != LocalEventCounter % 1024) {
 	status = true;
 	mRawSummary.faultFlags |= trmFaultBit;
 	mTRMCounters[itrm].EventCounterMismatch++;
 	mRawSummary.DiagnosticWord[iword] |= DIAGNOSTIC_TRM_EVENTCOUNTER;
-#ifdef CHECKER_VERBOSE
-	if (mCheckerVerbose) {
+	if (Policy::Trace && mCheckerVerbose) {
 	  printf(" TRM EventCounter / DRM LocalEventCounter mismatch: %d / %d (SlotID=%d) \n", EventCounter, LocalEventCounter, SlotID);
 	}
-#endif
 	continue;
       }
 
       /** check TRM EBit **/
-      if (GET_TRMGLOBALHEADER_EBIT(mRawSummary.TRMGlobalHeader[itrm])) {
+      if (GET_TRMGLOBALHEADER_EBIT(TRMGlobalHeader)) {
 	status = true;
 	mRawSummary.faultFlags |= trmFaultBit;
 	mTRMCounters[itrm].EBit++;
 	mRawSummary.DiagnosticWord[iword] |= DIAGNOSTIC_TRM_EBIT;
-#ifdef CHECKER_VERBOSE
-	if (mCheckerVerbose) {
+	if (Policy::Trace && mCheckerVerbose) {
 	  printf(" TRM EBit is on (SlotID=%d) \n", SlotID);
 	}
-#endif	
       }
       
       /** loop over TRM chains **/
@@ -1105,11 +1678,9 @@ TOFdecomp::check()
 	  status = true;
 	  mRawSummary.faultFlags |= chainFaultBit;
 	  mRawSummary.DiagnosticWord[iword] |= DIAGNOSTIC_TRMCHAIN_HEADER(ichain);
-#ifdef CHECKER_VERBOSE
-	  if (mCheckerVerbose) {
+	  if (Policy::Trace && mCheckerVerbose) {
 	    printf(" Missing TRM Chain Header (SlotID=%d, chain=%d) \n", SlotID, ichain);
 	  }
-#endif
 	  continue;
 	}
 
@@ -1118,11 +1689,9 @@ TOFdecomp::check()
 	  status = true;
 	  mRawSummary.faultFlags |= chainFaultBit;
 	  mRawSummary.DiagnosticWord[iword] |= DIAGNOSTIC_TRMCHAIN_TRAILER(ichain);
-#ifdef CHECKER_VERBOSE
-	  if (mCheckerVerbose) {
+	  if (Policy::Trace && mCheckerVerbose) {
 	    printf(" Missing TRM Chain Trailer (SlotID=%d, chain=%d) \n", SlotID, ichain);
 	  }
-#endif
 	  continue;
 	}
 
@@ -1135,11 +1704,9 @@ TOFdecomp::check()
 	  mRawSummary.faultFlags |= chainFaultBit;
 	  mTRMChainCounters[itrm][ichain].TDCerror++;
 	  mRawSummary.DiagnosticWord[iword] |= DIAGNOSTIC_TRMCHAIN_TDCERRORS(ichain);
-#ifdef CHECKER_VERBOSE
-	  if (mCheckerVerbose) {
+	  if (Policy::Trace && mCheckerVerbose) {
 	    printf(" TDC error detected (SlotID=%d, chain=%d) \n", SlotID, ichain);
 	  }
-#endif	  
 	}
 	
 	/** check TRM Chain EventCounter **/
@@ -1149,11 +1716,9 @@ TOFdecomp::check()
 	  mRawSummary.faultFlags |= chainFaultBit;
 	  mTRMChainCounters[itrm][ichain].EventCounterMismatch++;
 	  mRawSummary.DiagnosticWord[iword] |= DIAGNOSTIC_TRMCHAIN_EVENTCOUNTER(ichain);
-#ifdef CHECKER_VERBOSE
-	  if (mCheckerVerbose) {
+	  if (Policy::Trace && mCheckerVerbose) {
 	    printf(" TRM Chain EventCounter / DRM LocalEventCounter mismatch: %d / %d (SlotID=%d, chain=%d) \n", EventCounter, EventCounter, SlotID, ichain);
 	  }
-#endif
 	}
       
 	/** check TRM Chain Status **/
@@ -1163,11 +1728,9 @@ TOFdecomp::check()
 	  mRawSummary.faultFlags |= chainFaultBit;
 	  mTRMChainCounters[itrm][ichain].BadStatus++;
 	  mRawSummary.DiagnosticWord[iword] |= DIAGNOSTIC_TRMCHAIN_STATUS(ichain);
-#ifdef CHECKER_VERBOSE
-	  if (mCheckerVerbose) {
+	  if (Policy::Trace && mCheckerVerbose) {
 	    printf(" TRM Chain bad Status: %d (SlotID=%d, chain=%d) \n", Status, SlotID, ichain);
 	  }
-#endif	  
 	}
 
 	/** check TRM Chain BunchID **/
@@ -1177,11 +1740,9 @@ TOFdecomp::check()
 	  mRawSummary.faultFlags |= chainFaultBit;
 	  mTRMChainCounters[itrm][ichain].BunchIDMismatch++;
 	  mRawSummary.DiagnosticWord[iword] |= DIAGNOSTIC_TRMCHAIN_BUNCHID(ichain);
-#ifdef CHECKER_VERBOSE
-	  if (mCheckerVerbose) {
+	  if (Policy::Trace && mCheckerVerbose) {
 	    printf(" TRM Chain BunchID / DRM L0BCID mismatch: %d / %d (SlotID=%d, chain=%d) \n", BunchID, L0BCID, SlotID, ichain);
 	  }
-#endif	  
 	}
 
 	
@@ -1193,24 +1754,94 @@ TOFdecomp::check()
     if (mRawSummary.DiagnosticWord[iword] & 0xFFFFFFF0)
       mRawSummary.nDiagnosticWords++;
 
-#ifdef CHECKER_VERBOSE
-    if (mCheckerVerbose) {
+    if (Policy::Trace && mCheckerVerbose) {
       std::cout << colorBlue
 		<< "--- END CHECK EVENT: " << mRawSummary.nDiagnosticWords << " diagnostic words"
 		<< std::endl;
     }
-#endif
-
 
-    auto finish = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> elapsed = finish - start;
 
-    mIntegratedTime += elapsed.count();
+    TOF_PROBE_STOP(kCheck, probe, mRawSummary.nDiagnosticWords);
     
     return status;
 
 }
 
+void
+TOFdecomp::addCounters(const TOFdecomp &other)
+{
+  mCounter += other.mCounter;
+  mDRMCounters.Headers            += other.mDRMCounters.Headers;
+  mDRMCounters.EventWordsMismatch += other.mDRMCounters.EventWordsMismatch;
+  mDRMCounters.CBit               += other.mDRMCounters.CBit;
+  mDRMCounters.Fault              += other.mDRMCounters.Fault;
+  mDRMCounters.RTOBit             += other.mDRMCounters.RTOBit;
+  for (int itrm = 0; itrm < 10; ++itrm) {
+    mTRMCounters[itrm].Headers              += other.mTRMCounters[itrm].Headers;
+    mTRMCounters[itrm].Empty                += other.mTRMCounters[itrm].Empty;
+    mTRMCounters[itrm].EventCounterMismatch += other.mTRMCounters[itrm].EventCounterMismatch;
+    mTRMCounters[itrm].EventWordsMismatch   += other.mTRMCounters[itrm].EventWordsMismatch;
+    mTRMCounters[itrm].EBit                 += other.mTRMCounters[itrm].EBit;
+    for (int ichain = 0; ichain < 2; ++ichain) {
+      mTRMChainCounters[itrm][ichain].Headers              += other.mTRMChainCounters[itrm][ichain].Headers;
+      mTRMChainCounters[itrm][ichain].EventCounterMismatch += other.mTRMChainCounters[itrm][ichain].EventCounterMismatch;
+      mTRMChainCounters[itrm][ichain].BadStatus            += other.mTRMChainCounters[itrm][ichain].BadStatus;
+      mTRMChainCounters[itrm][ichain].BunchIDMismatch      += other.mTRMChainCounters[itrm][ichain].BunchIDMismatch;
+      mTRMChainCounters[itrm][ichain].TDCerror             += other.mTRMChainCounters[itrm][ichain].TDCerror;
+    }
+  }
+  mDecoderResyncs     += other.mDecoderResyncs;
+  mDecoderResyncBytes += other.mDecoderResyncBytes;
+  mDecoderPages       += other.mDecoderPages;
+  mDecoderBytes       += other.mDecoderBytes;
+  mDecoderEvents      += other.mDecoderEvents;
+  mEncoderBytes       += other.mEncoderBytes;
+  mIntegratedBytes += other.mIntegratedBytes;
+  if (mLatency && other.mLatency) mLatency->add(*other.mLatency);
+}
+
+void
+TOFdecomp::setLatency(bool val)
+{
+  if (val && !mLatency) mLatency = new TOFlatency;
+  if (!val && mLatency) {
+    delete mLatency;
+    mLatency = nullptr;
+  }
+}
+
+void
+TOFdecomp::setMetrics(TOFmetrics *val)
+{
+  mMetrics = val;
+  mMetricsSlot = val ? val->attach() : -1;
+  if (mMetricsSlot == -1) mMetrics = nullptr;
+}
+
+void
+TOFdecomp::getMetrics(TOFmetrics::Snapshot_t &snapshot) const
+{
+  snapshot.Pages       = mDecoderPages;
+  snapshot.BytesIn     = mDecoderBytes;
+  snapshot.BytesOut    = mEncoderBytes;
+  snapshot.Events      = mDecoderEvents;
+  snapshot.Checked     = mCounter;
+  snapshot.Resyncs     = mDecoderResyncs;
+  snapshot.ResyncBytes = mDecoderResyncBytes;
+  snapshot.DRM = mDRMCounters;
+  std::memcpy(snapshot.TRM, mTRMCounters, sizeof(snapshot.TRM));
+  std::memcpy(snapshot.TRMChain, mTRMChainCounters, sizeof(snapshot.TRMChain));
+}
+
+void
+TOFdecomp::stopMetrics()
+{
+  if (!mMetrics) return;
+  TOFmetrics::Snapshot_t snapshot;
+  getMetrics(snapshot);
+  mMetrics->stop(snapshot);
+}
+
 void
 TOFdecomp::checkSummary()
 {
@@ -1219,6 +1850,11 @@ TOFdecomp::checkSummary()
   std::cout << colorBlue
 	    <<"--- SUMMARY COUNTERS: " << mCounter << " events"
 	    << std::endl;
+  if (mDecoderResyncs > 0) {
+    std::cout << colorRed
+	      << "    resync: " << mDecoderResyncs << " times, " << mDecoderResyncBytes << " bytes skipped"
+	      << "\033[0m" << std::endl;
+  }
   if (mCounter == 0) return;
   printf("\n");
   printf("    DRM ");
@@ -1270,4 +1906,10 @@ TOFdecomp::checkSummary()
   printf("\n");
 }
 
+/** fast instantiations, the benchmark runs the stages on their own **/
+template void TOFdecomp::encoderCrateHeader<FastPolicy>();
+template void TOFdecomp::encoderFrames<FastPolicy>(uint32_t SlotID);
+template void TOFdecomp::encoderCrateTrailer<FastPolicy>();
+template bool TOFdecomp::check<FastPolicy>();
+
 }}
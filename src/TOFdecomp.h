@@ -3,12 +3,33 @@
 
 #include <fstream>
 #include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <cstdint>
 #include "dataFormat.h"
+#include "TOFpageWalker.h"
+#include "TOFasyncIO.h"
+#include "TOFsegments.h"
+#include "TOFsink.h"
+#include "TOFstream.h"
+#include "TOFring.h"
+#include "TOFmetrics.h"
+#include "TOFlatency.h"
 
 namespace tof {
 namespace data {
 
+/**
+ ** policies of the hot paths: decode(), the encoder and the checker are
+ ** instantiated once without any printout and once with the verbose
+ ** printouts, the tracing instantiation runs only if a verbose flag is set
+ **/
+struct FastPolicy  { static constexpr bool Trace = false; };
+struct TracePolicy { static constexpr bool Trace = true; };
+
 class TOFdecomp {
   
 public:
@@ -19,33 +40,68 @@ public:
   bool init();
   void rewind() { decoderRewind(); encoderRewind(); };
   bool open(std::string inFileName, std::string outFileName);
+  /** the compressed data go to a sink instead of an output file **/
+  bool open(std::string inFileName, TOFsink &sink);
+  inline bool openOutput(std::string outFileName) { return encoderOpen(outFileName); };
   bool close();
   inline bool read()  { return decoderRead(); };
-  inline bool write() { return encoderWrite(); };
+  bool write();
+  bool write(const std::vector<struct iovec> &iov);
+  inline bool write(const TOFsegments &output) { std::vector<struct iovec> iov; output.gather(iov); return write(iov); };
+  bool readPages(std::vector<const char *> &pages);
   
   bool decodeRDH();
   bool decode();
+  bool decodePage(const char *page, TOFsegments &output);
+  /**
+   ** decode the complete pages of a caller-owned memory span into a sink,
+   ** consumed is set to the bytes of the pages decoded; a sink with memory
+   ** receives the events in place and must have room for twice a page,
+   ** the other sinks get them every flush size and at the end of the span
+   **/
+  bool decode(const char *data, long size, TOFsink &sink, long *consumed = nullptr);
   void checkSummary();
+  void addCounters(const TOFdecomp &other);
   
-#ifdef DECODER_VERBOSE
   void setDecoderVerbose(bool val) { mDecoderVerbose = val; };
-#endif
-#ifdef ENCODER_VERBOSE
   void setEncoderVerbose(bool val) { mEncoderVerbose = val; };
-#endif
-#ifdef CHECKER_VERBOSE
   void setCheckerVerbose(bool val) { mCheckerVerbose = val; };
-#endif
   
   void setDecoderBufferSize(long val) { mDecoderBufferSize = val; };
+  void setDecoderMapped(bool val) { mDecoderMapped = val; };
+  void setAsyncIO(int depth, bool direct = false) { mAsyncDepth = depth; mDecoderDirect = direct; };
   void setEncoderBufferSize(long val) { mEncoderBufferSize = val; };
+  void setEncoderFlushPolicy(long size, double latency = 0.) { mEncoderFlushSize = size; mEncoderFlushLatency = latency; };
+  void setEncoderThreaded(bool val) { mEncoderThreaded = val; };
+
+  /** checker levels **/
+  enum ECheckLevel_t {
+    kCheckFull, // DRM, TRMs and chains
+    kCheckDRM,  // DRM headers and trailer only
+    kCheckOff   // no check, no diagnostic words
+  };
+  void setCheckLevel(int val) { mCheckLevel = val; };
+  int getCheckLevel() const { return mCheckLevel; };
 
   void setDRM(int val) {mDRM = val;};
+  int getDRM() const {return mDRM;};
   summary::RawSummary_t &getRawSummary() {return mRawSummary;};
+  long getResyncs() const { return mDecoderResyncs; };
+  long getResyncBytes() const { return mDecoderResyncBytes; };
+
+  /** live metrics, the decoder answers the exporter at each page **/
+  void setMetrics(TOFmetrics *val);
+  TOFmetrics *getMetrics() const { return mMetrics; };
+  void getMetrics(TOFmetrics::Snapshot_t &snapshot) const;
+  void stopMetrics();
+
+  /** latency histograms of events, pages and writes **/
+  void setLatency(bool val);
+  bool hasLatency() const { return mLatency != nullptr; };
+  void latencySummary() const { if (mLatency) mLatency->summary(); };
   
-  // benchmarks
+  // benchmarks, the time of the stages comes from the probes (TOFprobe.h)
   double mIntegratedBytes = 0.;
-  double mIntegratedTime = 0.;
   
 protected:
 
@@ -53,60 +109,137 @@ protected:
   
   bool decoderInit();
   bool decoderOpen(std::string name);
+  bool decoderOpenMapped(std::string name);
   bool decoderRead();
+  bool decoderFill();
   bool decoderClose();
-  inline void decoderRewind() { mDecoderPointer = (uint32_t *)mDecoderBuffer; mDecoderByteCounter = 0; };
+  inline bool decoderIsOpen() const { return mDecoderFile.is_open() || mDecoderMap || (mDecoderAsync && mDecoderAsync->isOpen()) || mDecoderStream.isOpen() || mDecoderRing; };
+  inline void decoderRewind() { mDecoderPointer = (uint32_t *)mDecoderPage; mDecoderByteCounter = 0; };
   inline void decoderClear();
+  inline void decoderClearTRM(int itrm);
   inline void decoderNext128();
-  inline void decoderNext32();
+  inline void decoderNext32() { mDecoderPointer++; };
+  void decoderDepad();
+  bool decoderResync();
+  inline bool decoderEventStart(const uint32_t *pointer) const;
 
   std::ifstream mDecoderFile;
+  /** standard input, named pipe or socket **/
+  TOFstream     mDecoderStream;
+  /** shared-memory ring, pages are decoded in place **/
+  TOFring      *mDecoderRing        = nullptr;
   char         *mDecoderBuffer      = nullptr;
-  long          mDecoderBufferSize  = 8192;
+  long          mDecoderBufferSize  = 8388608;
+  TOFpageWalker mDecoderWalker;
+  char         *mDecoderPage        = nullptr;
   uint32_t     *mDecoderPointer     = nullptr;
-#ifdef DECODER_VERBOSE
+  /** page payload without GBT padding, decoded with unit stride **/
+  uint32_t     *mDecoderDense       = nullptr;
+  uint32_t     *mDecoderDenseEnd    = nullptr;
+  bool          mDecoderMapped      = false;
+  int           mDecoderFD          = -1;
+  char         *mDecoderMap         = nullptr;
+  long          mDecoderMapSize     = 0;
+  TOFasyncReader *mDecoderAsync     = nullptr;
+  bool          mDecoderDirect      = false;
   bool          mDecoderVerbose     = false;
-#endif
-  uint32_t      mDecoderNextWord    = 1;
   uint32_t      mDecoderByteCounter = 0;
+  /** resynchronisations after corrupted data and payload bytes skipped **/
+  long          mDecoderResyncs     = 0;
+  long          mDecoderResyncBytes = 0;
+  /** pages, page bytes and events decoded **/
+  long          mDecoderPages       = 0;
+  long          mDecoderBytes       = 0;
+  long          mDecoderEvents      = 0;
 
   /** encoder stuff **/
   
   bool encoderInit();
   bool encoderOpen(std::string name);
+  inline bool encoderIsOpen() const { return mEncoderFD != -1 || (mEncoderAsync && mEncoderAsync->isOpen()) || mEncoderSink; };
   bool encoderWrite();
+  bool encoderWrite(const std::vector<struct iovec> &iov);
+  bool encoderOutput(const std::vector<struct iovec> &iov);
+  bool encoderFlush();
+  void encoderWait();
+  void encoderThreadLoop();
   inline bool encoderClose();
-  inline void encoderRewind() { mEncoderPointer = (uint32_t *)mEncoderBuffer; mEncoderByteCounter = 0; };
+  inline void encoderReserve(long size) { mEncoderEvent = mEncoderSegments->reserve(size); encoderRewind(); };
+  inline void encoderRewind() { mEncoderPointer = (uint32_t *)mEncoderEvent; mEncoderByteCounter = 0; };
   inline void encoderNext32();
+  template <typename Policy = FastPolicy> void encoderCrateHeader();
+  template <typename Policy = FastPolicy> void encoderFrames(uint32_t SlotID);
+  template <typename Policy = FastPolicy> void encoderCrateTrailer();
 
-  std::ofstream mEncoderFile;
-  char         *mEncoderBuffer      = nullptr;
-  long          mEncoderBufferSize  = 8192;
+  int           mEncoderFD          = -1;
+  TOFsink      *mEncoderSink        = nullptr;
+  /** output of decode() from a span, for the sinks without memory **/
+  TOFsegments   mEncoderSpan;
+  bool          mEncoderFull        = false;
+  TOFsegments   mEncoderChain[2];
+  TOFsegments  *mEncoderSegments    = &mEncoderChain[0];
+  char         *mEncoderEvent       = nullptr;
+  long          mEncoderBufferSize  = 1048576;
+  long          mEncoderFlushSize   = 8388608;
+  double        mEncoderFlushLatency = 0.;
+  std::chrono::steady_clock::time_point mEncoderFlushTime;
   uint32_t     *mEncoderPointer     = nullptr;
-#ifdef ENCODER_VERBOSE
   bool          mEncoderVerbose     = false;
-#endif
   uint32_t      mEncoderNextWord    = 1;
   uint32_t      mEncoderByteCounter = 0;
+  long          mEncoderBytes       = 0;
+  /** writer thread, flushing one chain while the other is filled **/
+  bool          mEncoderThreaded    = false;
+  std::thread   mEncoderThread;
+  std::mutex    mEncoderMutex;
+  std::condition_variable mEncoderCondition;
+  TOFsegments  *mEncoderPending     = nullptr;
+  bool          mEncoderStop        = false;
+  bool          mEncoderError       = false;
+  TOFasyncWriter *mEncoderAsync     = nullptr;
+  long          mEncoderAsyncBufferSize = 4194304;
+
+  /** asynchronous IO stuff **/
+
+  int           mAsyncDepth         = 0;
+  TOFasyncIO   *mAsyncIO            = nullptr;
   
   /** checker stuff **/
   
-#ifdef CHECKER_VERBOSE
   bool          mCheckerVerbose     = false;
-#endif
-  uint32_t                     mCounter;
-  counters::DRMCounters_t      mDRMCounters;
-  counters::TRMCounters_t      mTRMCounters[10];
-  counters::TRMChainCounters_t mTRMChainCounters[10][2];
+  int           mCheckLevel         = kCheckFull;
+  uint32_t                     mCounter                  = 0;
+  counters::DRMCounters_t      mDRMCounters              = {};
+  counters::TRMCounters_t      mTRMCounters[10]          = {};
+  counters::TRMChainCounters_t mTRMChainCounters[10][2]  = {};
 
   
+  /** metrics stuff **/
+
+  TOFmetrics   *mMetrics            = nullptr;
+  int           mMetricsSlot        = -1;
+
+  /** latency stuff **/
+
+  inline void latencyEvent(uint64_t start, uint64_t check);
+  inline void latencyPage();
+
+  TOFlatency   *mLatency            = nullptr;
+  /** ticks of the current page and event so far **/
+  uint64_t      mLatencyPage        = 0;
+  uint64_t      mLatencyPageSpider  = 0;
+  uint64_t      mLatencyPageCheck   = 0;
+  uint64_t      mLatencyEventSpider = 0;
+
   /** common stuff **/
 
+  template <typename Policy> bool decodeEvent();
   void spider();
-  bool check();
+  template <typename Policy = FastPolicy, int Level = kCheckFull> bool check();
   
   raw::RDH_t *mRDH;  
   summary::RawSummary_t mRawSummary = {0};    
+  summary::HitSummary_t *mHitSummary = nullptr;
   uint32_t mDRM = -1;
     
 };
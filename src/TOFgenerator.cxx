@@ -0,0 +1,330 @@
+#include "TOFgenerator.h"
+#include "TOFpageWalker.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#define colorRed     "\033[1;31m"
+#define colorYellow  "\033[1;33m"
+#define colorBlue    "\033[1;34m"
+
+namespace tof {
+namespace data {
+
+namespace {
+
+  /** indexed by EFault_t **/
+  const char *sFaultName[] = {
+    "drm-cbit",
+    "drm-faultid",
+    "drm-rtobit",
+    "drm-enablemask",
+    "trm-missing",
+    "trm-trailer",
+    "trm-unexpected",
+    "trm-eventcounter",
+    "trm-ebit",
+    "chain-missing",
+    "chain-trailer",
+    "chain-status",
+    "chain-eventcounter",
+    "chain-bunchid",
+    "chain-tdcerror",
+    "link-corrupt"
+  };
+
+  const char *sFaultDescription[] = {
+    "DRM CBit on (per event)",
+    "DRM FaultID not zero (per event)",
+    "DRM RTOBit on (per event)",
+    "DRM enable/participating mask differ (per event)",
+    "TRM header and data missing (per TRM)",
+    "TRM trailer missing (per TRM)",
+    "TRM data from non-participating slot (per TRM)",
+    "TRM EventCounter mismatch (per TRM)",
+    "TRM EBit on (per TRM)",
+    "TRM chain missing (per chain)",
+    "TRM chain trailer missing (per chain)",
+    "TRM chain bad status (per chain)",
+    "TRM chain EventCounter mismatch (per chain)",
+    "TRM chain BunchID mismatch (per chain)",
+    "TDC error word in chain (per chain)",
+    "Burst of random words over the event data (per event)"
+  };
+
+  const uint32_t sFiller = 0x70000000;
+  /** largest page that keeps 128-bit alignment **/
+  const long sMaxPageSize = TOFpageWalker::MaxPageSize & ~0xF;
+  /** leading hits per TDC, leading and trailing must fit the decoder 8-bit hit counter **/
+  const int sMaxHitsPerTDC = 127;
+  /** longest burst of corrupted words **/
+  const unsigned long sMaxCorruptWords = 16;
+
+}
+
+const char *
+TOFgenerator::getFaultName(int ifault)
+{
+  return sFaultName[ifault];
+}
+
+const char *
+TOFgenerator::getFaultDescription(int ifault)
+{
+  return sFaultDescription[ifault];
+}
+
+bool
+TOFgenerator::open(std::string name)
+{
+  mFile.open(name.c_str(), std::fstream::out | std::fstream::binary);
+  if (!mFile.is_open()) {
+    std::cerr << colorRed
+	      << "-E- Cannot open output file: " << name
+	      << std::endl;
+    return true;
+  }
+  std::cout << colorBlue
+	    << "--- Opened output file: " << name
+	    << std::endl;
+  return false;
+}
+
+bool
+TOFgenerator::close()
+{
+  if (!mFile.is_open()) return true;
+  mFile.close();
+  return false;
+}
+
+bool
+TOFgenerator::generate(long nEvents)
+{
+  if (mPageSize < TOFpageWalker::RDHSize + 16 || mPageSize > sMaxPageSize) {
+    std::cerr << colorRed
+	      << "-E- page size must be between " << TOFpageWalker::RDHSize + 16 << " and " << sMaxPageSize << " bytes"
+	      << std::endl;
+    return true;
+  }
+  mPageSize &= ~0xF;
+  if (mLinks < 1) mLinks = 1;
+  mLink.resize(mLinks);
+  for (auto &link : mLink)
+    if (link.Page.empty()) link.Page.resize(TOFpageWalker::RDHSize);
+
+  for (long ievent = 0; ievent < nEvents; ++ievent) {
+    int ilink = ievent % mLinks;
+    auto &link = mLink[ilink];
+
+    event(ievent / mLinks, link.Orbit);
+
+    /** two payload words per GBT word, the event ends on a GBT boundary **/
+    long eventSize = mEvent.size() / 2 * 16;
+    if (TOFpageWalker::RDHSize + eventSize > sMaxPageSize) {
+      mDropped++;
+      continue;
+    }
+
+    /** flush the page if the event does not fit or the page is full **/
+    long pageFill = link.Page.size();
+    if (link.Events > 0 && (pageFill + eventSize > mPageSize || (mEventsPerPage > 0 && link.Events == mEventsPerPage)))
+      if (writePage(ilink, false)) return true;
+
+    /** pad to GBT words **/
+    pageFill = link.Page.size();
+    link.Page.resize(pageFill + eventSize, 0);
+    auto gbt = reinterpret_cast<uint32_t *>(link.Page.data() + pageFill);
+    for (size_t iword = 0; iword < mEvent.size(); iword += 2, gbt += 4) {
+      gbt[0] = mEvent[iword];
+      gbt[1] = mEvent[iword + 1];
+    }
+    link.Events++;
+    mEvents++;
+  }
+
+  /** flush the last pages **/
+  for (int ilink = 0; ilink < mLinks; ++ilink)
+    if (mLink[ilink].Events > 0 && writePage(ilink, true)) return true;
+
+  return false;
+}
+
+bool
+TOFgenerator::writePage(int ilink, bool last)
+{
+  auto &link = mLink[ilink];
+  long memorySize = link.Page.size();
+  long pageSize = std::max(mPageSize, (memorySize + 15) & ~0xF);
+  link.Page.resize(pageSize, 0);
+
+  /** RDH **/
+  std::memset(link.Page.data(), 0, TOFpageWalker::RDHSize);
+  auto rdh = reinterpret_cast<raw::RDH_t *>(link.Page.data());
+  rdh[0].Word0.HeaderVersion   = 4;
+  rdh[0].Word0.HeaderSize      = TOFpageWalker::RDHSize;
+  rdh[0].Word0.BlockLength     = memorySize;
+  rdh[0].Word0.FeeID           = mFeeID + ilink;
+  rdh[0].Word0.OffsetNewPacket = pageSize;
+  rdh[0].Word0.MemorySize      = memorySize;
+  rdh[0].Word0.PacketCounter   = link.PacketCounter++;
+  rdh[0].Word0.CruID           = mCruID;
+  rdh[1].Word1.TrgOrbit        = link.Orbit;
+  rdh[1].Word1.HbOrbit         = link.Orbit;
+  rdh[3].Word3.StopBit         = last;
+  rdh[3].Word3.PagesCounter    = link.PagesCounter++;
+  link.Orbit++;
+
+  if (mBuffer)
+    mBuffer->insert(mBuffer->end(), link.Page.begin(), link.Page.end());
+  else
+    mFile.write(link.Page.data(), pageSize);
+  if (!mBuffer && !mFile.good()) {
+    std::cerr << colorRed
+	      << "-E- output write failed"
+	      << std::endl;
+    return true;
+  }
+  mPages++;
+  mBytes += pageSize;
+
+  link.Page.resize(TOFpageWalker::RDHSize);
+  link.Events = 0;
+  return false;
+}
+
+void
+TOFgenerator::event(long ievent, uint32_t orbit)
+{
+  mEvent.clear();
+  uint32_t eventCounter = ievent & 0xFFF;
+  uint32_t bunchID = mRandom() & 0xFFF;
+
+  /** participating TRMs **/
+  uint32_t participating = 0, unexpected = 0, missing = 0;
+  for (int itrm = 0; itrm < 10; ++itrm) {
+    if (mTRMFraction < 1. && mUniform(mRandom) >= mTRMFraction) continue;
+    if (fault(kTRMUnexpected)) unexpected |= 1 << (itrm + 1);
+    else if (fault(kTRMMissing)) missing |= 1 << (itrm + 1);
+    participating |= 1 << (itrm + 1);
+  }
+  participating &= ~unexpected;
+  uint32_t enableMask = participating;
+  if (fault(kDRMEnableMask)) enableMask ^= 0x1;
+
+  /** DRM headers, the event words are set at the end **/
+  mEvent.push_back(0x40000000);
+  mEvent.push_back(orbit);
+  mEvent.push_back(0x40000001 | mDRMID << 21);
+  mEvent.push_back(0x40000001 | participating << 4 | fault(kDRMCBit) << 15 | 5 << 21);
+  uint32_t faultID = fault(kDRMFaultID) ? 1 + mRandom() % 0x7FF : 0;
+  mEvent.push_back(0x40000001 | enableMask << 4 | faultID << 16 | fault(kDRMRTOBit) << 27);
+  mEvent.push_back(0x40000001 | bunchID << 4);
+  mEvent.push_back(0x40000001);
+  mEvent.push_back(0x40000001);
+
+  /** LTM **/
+  if (mLTM) {
+    mEvent.push_back(0x40000002);
+    for (int iword = 0; iword < 4; ++iword)
+      mEvent.push_back(iword);
+    mEvent.push_back(0x50000002);
+  }
+
+  /** TRMs **/
+  for (int itrm = 0; itrm < 10; ++itrm) {
+    uint32_t bit = 1 << (itrm + 1);
+    if (!((participating | unexpected) & bit) || (missing & bit)) continue;
+    trm(itrm, eventCounter, bunchID);
+  }
+
+  /** DRM trailer and filler to close the GBT word **/
+  mEvent.push_back(0x50000001 | eventCounter << 4);
+  if (mEvent.size() % 2) mEvent.push_back(sFiller);
+
+  mEvent[0] |= mEvent.size() & 0x0FFFFFFF;
+  mEvent[2] |= (mEvent.size() & 0x1FFFF) << 4;
+
+  /** link corruption, the event size is kept **/
+  if (fault(kLinkCorrupt)) {
+    auto first = mRandom() % mEvent.size();
+    auto last = std::min(mEvent.size(), first + 1 + mRandom() % sMaxCorruptWords);
+    for (auto iword = first; iword < last; ++iword)
+      mEvent[iword] = mRandom();
+  }
+}
+
+void
+TOFgenerator::trm(int itrm, uint32_t eventCounter, uint32_t bunchID)
+{
+  uint32_t slotID = itrm + 3;
+  auto first = mEvent.size();
+  uint32_t eventNumber = fault(kTRMEventCounter) ? (eventCounter + 1) % 1024 : eventCounter % 1024;
+  mEvent.push_back(0x40000000 | slotID | eventNumber << 17 | fault(kTRMEBit) << 27);
+
+  for (int ichain = 0; ichain < 2; ++ichain) {
+    if (fault(kChainMissing)) continue;
+    chain(itrm, ichain, eventCounter, bunchID);
+  }
+
+  /** a missing trailer is replaced by a filler, so that the decoder skips one word **/
+  mEvent.push_back(fault(kTRMTrailer) ? sFiller : 0x50000003 | (mRandom() & 0xFFF) << 2);
+  mEvent[first] |= ((mEvent.size() - first) & 0x1FFF) << 4;
+}
+
+void
+TOFgenerator::chain(int itrm, int ichain, uint32_t eventCounter, uint32_t bunchID)
+{
+  uint32_t slotID = itrm + 3;
+  uint32_t chainBunchID = fault(kChainBunchID) ? (bunchID + 1) & 0xFFF : bunchID;
+  mEvent.push_back(ichain << 29 | slotID | chainBunchID << 4);
+
+  /** hits, each TDC reads out its leading and trailing edges in time order **/
+  std::poisson_distribution<int> poisson(mHitsPerTDC > 0. ? mHitsPerTDC : 1.);
+  for (int itdc = 0; itdc < 15; ++itdc) {
+    int nhits = mHitsPerTDC > 0. ? std::min(poisson(mRandom), sMaxHitsPerTDC) : 0;
+    mHits.clear();
+    for (int ihit = 0; ihit < nhits; ++ihit) {
+      uint32_t chan = mRandom() & 0x7;
+      uint32_t time = mRandom() % (0x200000 - 0x800);
+      mHits.push_back(0x80000000 | 0x1 << 29 | itdc << 24 | chan << 21 | time);
+      if (mTrailingFraction >= 1. || mUniform(mRandom) < mTrailingFraction) {
+	uint32_t tot = 1 + mRandom() % 0x7FF;
+	mHits.push_back(0x80000000 | 0x2 << 29 | itdc << 24 | chan << 21 | (time + tot));
+      }
+    }
+    std::sort(mHits.begin(), mHits.end(), [](uint32_t a, uint32_t b) { return GET_TDCHIT_HITTIME(a) < GET_TDCHIT_HITTIME(b); });
+    mEvent.insert(mEvent.end(), mHits.begin(), mHits.end());
+    mTDCHits += mHits.size();
+  }
+  if (fault(kChainTDCError))
+    mEvent.push_back(0x60000000 | (mRandom() % 15) << 24 | (mRandom() & 0x7FFF));
+
+  /** a missing trailer is replaced by a filler, so that the decoder skips one word **/
+  uint32_t status = fault(kChainStatus) ? 1 + mRandom() % 15 : 0;
+  uint32_t chainEventCounter = fault(kChainEventCounter) ? (eventCounter + 1) & 0xFFF : eventCounter;
+  mEvent.push_back(fault(kChainTrailer) ? sFiller : (ichain << 29 | 0x10000000 | status | chainEventCounter << 16));
+}
+
+void
+TOFgenerator::summary()
+{
+  std::cout << colorBlue
+	    << "--- GENERATOR SUMMARY: " << mEvents << " events"
+	    << "\033[0m" << std::endl;
+  printf("\n");
+  printf("      pages: %10ld \n", mPages);
+  printf("      bytes: %10ld   (%6.2f / event) \n", mBytes, mEvents ? (double)mBytes / mEvents : 0.);
+  printf("   TDC hits: %10ld   (%6.2f / event) \n", mTDCHits, mEvents ? (double)mTDCHits / mEvents : 0.);
+  if (mDropped > 0)
+    printf("%s    dropped: %10ld   (events larger than a page)\033[0m \n", colorYellow, mDropped);
+  printf("\n");
+  for (int ifault = 0; ifault < kNFaults; ++ifault) {
+    if (mFaults[ifault] == 0) continue;
+    printf(" %20s: %10ld \n", sFaultName[ifault], mFaults[ifault]);
+  }
+  printf("\n");
+}
+
+}}
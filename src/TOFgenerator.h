@@ -0,0 +1,125 @@
+#ifndef _TOF_GENERATOR_H_
+#define _TOF_GENERATOR_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdint>
+#include "dataFormat.h"
+
+namespace tof {
+namespace data {
+
+/**
+ ** synthetic raw data generator
+ ** writes RDH pages with DRM/LTM/TRM/chain/TDC words laid out as the
+ ** decoder expects them, two 32-bit words per 128-bit GBT word, with
+ ** configurable occupancy and per-fault injection rates
+ **/
+
+class TOFgenerator {
+
+public:
+
+  /** faults that the checker detects, corrupted words are skipped by the decoder resync **/
+  enum EFault_t {
+    kDRMCBit,
+    kDRMFaultID,
+    kDRMRTOBit,
+    kDRMEnableMask,
+    kTRMMissing,
+    kTRMTrailer,
+    kTRMUnexpected,
+    kTRMEventCounter,
+    kTRMEBit,
+    kChainMissing,
+    kChainTrailer,
+    kChainStatus,
+    kChainEventCounter,
+    kChainBunchID,
+    kChainTDCError,
+    kLinkCorrupt,
+    kNFaults
+  };
+
+  static const char *getFaultName(int ifault);
+  static const char *getFaultDescription(int ifault);
+
+  TOFgenerator() {};
+  ~TOFgenerator() { close(); };
+
+  bool open(std::string name);
+  bool close();
+  /** generate events and write them in pages **/
+  bool generate(long nEvents);
+  /** generate events into a memory buffer, pages are appended **/
+  bool generate(long nEvents, std::vector<char> &buffer) { mBuffer = &buffer; bool status = generate(nEvents); mBuffer = nullptr; return status; };
+  void summary();
+
+  void setSeed(uint64_t val) { mRandom.seed(val); };
+  void setHitsPerTDC(double val) { mHitsPerTDC = val; };
+  void setTrailingFraction(double val) { mTrailingFraction = val; };
+  void setEventsPerPage(int val) { mEventsPerPage = val; };
+  void setPageSize(long val) { mPageSize = val; };
+  void setTRMFraction(double val) { mTRMFraction = val; };
+  void setLTM(bool val) { mLTM = val; };
+  void setLinks(int val) { mLinks = val; };
+  void setFeeID(int val) { mFeeID = val; };
+  void setCruID(int val) { mCruID = val; };
+  void setDRMID(int val) { mDRMID = val; };
+  void setFaultRate(int ifault, double val) { mFaultRate[ifault] = val; };
+
+private:
+
+  void event(long ievent, uint32_t orbit);
+  void trm(int itrm, uint32_t eventCounter, uint32_t bunchID);
+  void chain(int itrm, int ichain, uint32_t eventCounter, uint32_t bunchID);
+  bool writePage(int ilink, bool last);
+  inline bool fault(int ifault) { if (mFaultRate[ifault] > 0. && mUniform(mRandom) < mFaultRate[ifault]) { mFaults[ifault]++; return true; } return false; };
+
+  /** parameters **/
+  double   mHitsPerTDC       = 1.;
+  double   mTrailingFraction = 1.;
+  int      mEventsPerPage    = 1;
+  long     mPageSize         = 8192;
+  double   mTRMFraction      = 1.;
+  bool     mLTM              = false;
+  int      mLinks            = 1;
+  int      mFeeID            = 0;
+  int      mCruID            = 0;
+  int      mDRMID            = 0;
+  double   mFaultRate[kNFaults] = {};
+
+  std::mt19937_64                        mRandom;
+  std::uniform_real_distribution<double> mUniform;
+
+  /** event words, without GBT padding **/
+  std::vector<uint32_t> mEvent;
+  std::vector<uint32_t> mHits;
+  /** page being filled for each link **/
+  struct Link {
+    std::vector<char> Page;
+    int               Events        = 0;
+    uint32_t          PacketCounter = 0;
+    uint32_t          PagesCounter  = 0;
+    uint32_t          Orbit         = 0;
+  };
+  std::vector<Link> mLink;
+
+  std::ofstream      mFile;
+  std::vector<char> *mBuffer = nullptr;
+
+  /** counters **/
+  long mEvents  = 0;
+  long mPages   = 0;
+  long mBytes   = 0;
+  long mTDCHits = 0;
+  long mDropped = 0;
+  long mFaults[kNFaults] = {};
+
+};
+
+}}
+
+#endif /** _TOF_GENERATOR_H_ **/
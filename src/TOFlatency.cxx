@@ -0,0 +1,190 @@
+#include "TOFlatency.h"
+#include <iostream>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <csignal>
+#include <pthread.h>
+#include <unistd.h>
+
+#define colorBlue    "\033[1;34m"
+
+namespace tof {
+namespace data {
+
+namespace {
+
+  const char *sLevelName[TOFlatency::kNHistograms] = {
+    "event", "event", "event", "page", "page", "page", "write"
+  };
+  const char *sStageName[TOFlatency::kNHistograms] = {
+    "decode", "spider", "check", "decode", "spider", "check", "call"
+  };
+
+  /** live sets, for the summaries on demand **/
+  std::mutex                sMutex;
+  std::vector<TOFlatency *> sLive;
+
+  /** time-stamp counter and steady clock at start-up, to calibrate the counter rate **/
+  struct Origin_t {
+    uint64_t                              Ticks = __rdtsc();
+    std::chrono::steady_clock::time_point Time  = std::chrono::steady_clock::now();
+  } sOrigin;
+
+  double
+  ticksPerMicrosecond()
+  {
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - sOrigin.Time;
+    return (__rdtsc() - sOrigin.Ticks) / elapsed.count();
+  }
+
+  /** takes SIGUSR1, stopped at exit if unwatch() was not called **/
+  struct Watcher_t {
+    std::thread       Thread;
+    std::atomic<bool> Stop{false};
+    void stop() {
+      if (!Thread.joinable()) return;
+      Stop = true;
+      pthread_kill(Thread.native_handle(), SIGUSR1);
+      Thread.join();
+    };
+    ~Watcher_t() { stop(); };
+  } sWatcher;
+
+}
+
+void
+TOFhistogram::clear()
+{
+  for (auto &counter : mCounts) counter.store(0, std::memory_order_relaxed);
+  mCount.store(0, std::memory_order_relaxed);
+  mMax.store(0, std::memory_order_relaxed);
+}
+
+void
+TOFhistogram::add(const TOFhistogram &other)
+{
+  for (int ibucket = 0; ibucket < kBuckets; ++ibucket)
+    increment(mCounts[ibucket], other.mCounts[ibucket].load(std::memory_order_relaxed));
+  increment(mCount, other.count());
+  if (other.max() > max()) mMax.store(other.max(), std::memory_order_relaxed);
+}
+
+uint64_t
+TOFhistogram::highest(int bucket)
+{
+  if (bucket < (1 << kSubBits)) return bucket;
+  int shift = (bucket >> (kSubBits - 1)) - 1;
+  uint64_t mantissa = bucket - (shift << (kSubBits - 1));
+  return ((mantissa + 1) << shift) - 1;
+}
+
+uint64_t
+TOFhistogram::percentile(double fraction) const
+{
+  uint64_t total = count();
+  if (total == 0) return 0;
+  uint64_t target = fraction * total;
+  if (target < 1) target = 1;
+  uint64_t sum = 0;
+  for (int ibucket = 0; ibucket < kBuckets; ++ibucket) {
+    sum += mCounts[ibucket].load(std::memory_order_relaxed);
+    if (sum >= target) return std::min(highest(ibucket), max());
+  }
+  return max();
+}
+
+TOFlatency::TOFlatency()
+{
+  std::lock_guard<std::mutex> lock(sMutex);
+  sLive.push_back(this);
+}
+
+TOFlatency::~TOFlatency()
+{
+  std::lock_guard<std::mutex> lock(sMutex);
+  sLive.erase(std::remove(sLive.begin(), sLive.end(), this), sLive.end());
+}
+
+void
+TOFlatency::add(TOFlatency &other)
+{
+  for (int ihisto = 0; ihisto < kNHistograms; ++ihisto)
+    mHistograms[ihisto].add(other.mHistograms[ihisto]);
+  other.mMerged = true;
+}
+
+void
+TOFlatency::summary() const
+{
+  print(mHistograms, "LATENCY SUMMARY");
+}
+
+void
+TOFlatency::print(const TOFhistogram *histograms, const char *title)
+{
+  double ticks = ticksPerMicrosecond();
+  std::cout << colorBlue
+	    << "--- " << title << ": " << histograms[kEventDecode].count() << " events, "
+	    << histograms[kPageDecode].count() << " pages, " << histograms[kWrite].count() << " writes"
+	    << "\033[0m" << std::endl;
+  printf("\n");
+  printf("    %-6s %-8s %12s %10s %10s %10s %10s \n", "level", "stage", "count", "p50 us", "p99 us", "p99.9 us", "max us");
+  for (int ihisto = 0; ihisto < kNHistograms; ++ihisto) {
+    auto &histogram = histograms[ihisto];
+    printf("    %-6s %-8s %12lu ", sLevelName[ihisto], sStageName[ihisto], histogram.count());
+    if (histogram.count() == 0) {
+      printf("%10s %10s %10s %10s \n", "-", "-", "-", "-");
+      continue;
+    }
+    printf("%10.3f %10.3f %10.3f %10.3f \n", histogram.percentile(0.5) / ticks, histogram.percentile(0.99) / ticks,
+	   histogram.percentile(0.999) / ticks, histogram.max() / ticks);
+  }
+  printf("\n");
+}
+
+void
+TOFlatency::summaryLive()
+{
+  auto merged = new TOFhistogram[kNHistograms];
+  {
+    std::lock_guard<std::mutex> lock(sMutex);
+    for (auto latency : sLive) {
+      if (latency->mMerged) continue;
+      for (int ihisto = 0; ihisto < kNHistograms; ++ihisto)
+	merged[ihisto].add(latency->mHistograms[ihisto]);
+    }
+  }
+  print(merged, "LATENCY SO FAR");
+  delete [] merged;
+}
+
+void
+TOFlatency::watch()
+{
+  if (sWatcher.Thread.joinable()) return;
+  /** the signal is blocked here and in every thread started later, the watcher takes it **/
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  sWatcher.Thread = std::thread([signals] {
+      int signal;
+      while (sigwait(&signals, &signal) == 0 && !sWatcher.Stop)
+	summaryLive();
+    });
+  std::cout << colorBlue
+	    << "--- LATENCY: kill -USR1 " << getpid() << " prints the histograms so far"
+	    << "\033[0m" << std::endl;
+}
+
+void
+TOFlatency::unwatch()
+{
+  sWatcher.stop();
+}
+
+}}
@@ -0,0 +1,113 @@
+#ifndef _TOF_LATENCY_H_
+#define _TOF_LATENCY_H_
+
+#include <atomic>
+#include <cstdint>
+#include <x86intrin.h>
+
+namespace tof {
+namespace data {
+
+/**
+ ** log-linear latency histogram in the HDR style
+ ** values below 128 have their own bucket, above that each power of two
+ ** is split in 64 buckets (1.6% resolution) up to 2^40; there is a single
+ ** writer, the counts are relaxed atomics so that another thread may read
+ ** them while they grow
+ **/
+
+class TOFhistogram {
+
+public:
+
+  static const int      kSubBits = 7;
+  static const int      kBuckets = (40 - kSubBits + 2) << (kSubBits - 1);
+  static const uint64_t kMaxValue = (1ull << 40) - 1;
+
+  TOFhistogram() { clear(); };
+
+  void clear();
+
+  inline void record(uint64_t value) {
+    if (value > kMaxValue) value = kMaxValue;
+    increment(mCounts[bucket(value)], 1);
+    increment(mCount, 1);
+    if (value > mMax.load(std::memory_order_relaxed)) mMax.store(value, std::memory_order_relaxed);
+  };
+
+  void add(const TOFhistogram &other);
+  uint64_t count() const { return mCount.load(std::memory_order_relaxed); };
+  uint64_t max() const { return mMax.load(std::memory_order_relaxed); };
+  /** highest value of the bucket holding this fraction of the counts **/
+  uint64_t percentile(double fraction) const;
+
+private:
+
+  static inline int bucket(uint64_t value) {
+    if (value < (1 << kSubBits)) return value;
+    int shift = 63 - __builtin_clzll(value) - (kSubBits - 1);
+    return (shift << (kSubBits - 1)) + (value >> shift);
+  };
+  static uint64_t highest(int bucket);
+
+  /** single writer, no locked instruction **/
+  static inline void increment(std::atomic<uint64_t> &counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  };
+
+  std::atomic<uint64_t> mCounts[kBuckets];
+  std::atomic<uint64_t> mCount;
+  std::atomic<uint64_t> mMax;
+
+};
+
+/**
+ ** latency histograms of a decoder, in time-stamp counter ticks
+ ** events and pages are recorded separately for decode, spider and check,
+ ** writes for each call; the histograms of the worker decoders are merged
+ ** into the master with add(), every live set can be printed on demand
+ ** (SIGUSR1) while the decoders run
+ **/
+
+class TOFlatency {
+
+public:
+
+  enum EHistogram_t {
+    kEventDecode,
+    kEventSpider,
+    kEventCheck,
+    kPageDecode,
+    kPageSpider,
+    kPageCheck,
+    kWrite,
+    kNHistograms
+  };
+
+  TOFlatency();
+  ~TOFlatency();
+
+  inline TOFhistogram &operator[](int histogram) { return mHistograms[histogram]; };
+  static inline uint64_t now() { return __rdtsc(); };
+
+  /** merge the histograms of another set, it is no longer printed on demand **/
+  void add(TOFlatency &other);
+  void summary() const;
+
+  /** print the sum of the live sets on SIGUSR1, call before any thread is started **/
+  static void watch();
+  static void unwatch();
+
+private:
+
+  static void print(const TOFhistogram *histograms, const char *title);
+  static void summaryLive();
+
+  TOFhistogram       mHistograms[kNHistograms];
+  std::atomic<bool>  mMerged{false};
+
+};
+
+}}
+
+#endif /** _TOF_LATENCY_H_ **/
@@ -0,0 +1,169 @@
+#include "TOFlinks.h"
+#include <iostream>
+
+#define colorRed     "\033[1;31m"
+#define colorBlue    "\033[1;34m"
+
+namespace tof {
+namespace data {
+
+TOFlinks::TOFlinks(int nWorkers) :
+  mNWorkers(nWorkers)
+{
+}
+
+TOFlinks::~TOFlinks()
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStop = true;
+  }
+  mStartCondition.notify_all();
+  for (auto &thread : mThreads) thread.join();
+  for (auto &link : mLinks) {
+    delete link.second->Decoder;
+    delete link.second;
+  }
+}
+
+bool
+TOFlinks::init(const TOFdecomp &master)
+{
+  if (mNWorkers < 1) {
+    std::cerr << colorRed
+	      << "-E- invalid number of link workers: " << mNWorkers
+	      << std::endl;
+    return true;
+  }
+  std::cout << colorBlue
+	    << "--- INITIALISE LINK DECODER: " << mNWorkers << " workers"
+	    << std::endl;
+  mDRM = master.getDRM();
+  mCheckLevel = master.getCheckLevel();
+  mMetrics = master.getMetrics();
+  mLatency = master.hasLatency();
+  mTasks.resize(mNWorkers);
+  mOutputs.resize(mNWorkers);
+  for (int iworker = 0; iworker < mNWorkers; ++iworker)
+    mThreads.push_back(std::thread(&TOFlinks::worker, this, iworker));
+  return false;
+}
+
+TOFlinks::Link *
+TOFlinks::getLink(const char *page)
+{
+  auto rdh = reinterpret_cast<const raw::RDHWord0_t *>(page);
+  uint32_t key = rdh->CruID << 16 | rdh->FeeID;
+  auto it = mLinks.find(key);
+  if (it != mLinks.end()) return it->second;
+
+  /** new link, bound to the next worker in turn **/
+  auto link = new Link;
+  link->CruID = rdh->CruID;
+  link->FeeID = rdh->FeeID;
+  link->Worker = mLinks.size() % mNWorkers;
+  link->Decoder = new TOFdecomp;
+  link->Decoder->setDRM(mDRM);
+  link->Decoder->setCheckLevel(mCheckLevel);
+  link->Decoder->setMetrics(mMetrics);
+  link->Decoder->setLatency(mLatency);
+  mLinks[key] = link;
+  if (link->Decoder->init()) return nullptr;
+  if (!mLinkOutput.empty()) {
+    std::string name = mLinkOutput + ".cru" + std::to_string(link->CruID) + ".fee" + std::to_string(link->FeeID);
+    if (link->Decoder->openOutput(name)) return nullptr;
+  }
+  std::cout << colorBlue
+	    << "--- NEW LINK: CruID=" << link->CruID << " FeeID=" << link->FeeID << " (worker " << link->Worker << ")"
+	    << std::endl;
+  return link;
+}
+
+void
+TOFlinks::worker(int iworker)
+{
+  long generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mStartCondition.wait(lock, [this, generation] { return mStop || mGeneration != generation; });
+      if (mStop) return;
+      generation = mGeneration;
+    }
+    auto &output = mOutputs[iworker];
+    for (auto &task : mTasks[iworker]) {
+      mPageBegin[task.Page] = output.size();
+      task.Target->Decoder->decodePage(mPages[task.Page], output);
+      mPageEnd[task.Page] = output.size();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mPending--;
+    }
+    mDoneCondition.notify_one();
+  }
+}
+
+bool
+TOFlinks::run(TOFdecomp &master)
+{
+  while (!master.readPages(mPages)) {
+
+    /** route pages to the link workers **/
+    auto npages = mPages.size();
+    mPageBegin.resize(npages);
+    mPageEnd.resize(npages);
+    mPageLinks.resize(npages);
+    for (auto &tasks : mTasks) tasks.clear();
+    for (size_t ipage = 0; ipage < npages; ++ipage) {
+      auto link = getLink(mPages[ipage]);
+      if (!link) return true;
+      mPageLinks[ipage] = link;
+      mTasks[link->Worker].push_back({link, (long)ipage});
+    }
+
+    /** decode and wait, pages are only valid until the next read **/
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mPending = mNWorkers;
+      mGeneration++;
+      mStartCondition.notify_all();
+      mDoneCondition.wait(lock, [this] { return mPending == 0; });
+    }
+
+    /** write in input order, and to the link output if requested **/
+    std::vector<struct iovec> iov;
+    for (size_t ipage = 0; ipage < npages; ++ipage) {
+      auto link = mPageLinks[ipage];
+      auto &output = mOutputs[link->Worker];
+      output.gather(iov, mPageBegin[ipage], mPageEnd[ipage]);
+      if (!mLinkOutput.empty())
+	output.gather(link->Output, mPageBegin[ipage], mPageEnd[ipage]);
+    }
+    if (master.write(iov)) return true;
+    for (auto &link : mLinks) {
+      if (link.second->Output.empty()) continue;
+      if (link.second->Decoder->write(link.second->Output)) return true;
+      link.second->Output.clear();
+    }
+    for (auto &output : mOutputs) output.clear();
+  }
+
+  /** merge the link counters for the global check summary **/
+  for (auto &link : mLinks)
+    master.addCounters(*link.second->Decoder);
+  return false;
+}
+
+void
+TOFlinks::checkSummary()
+{
+  for (auto &link : mLinks) {
+    std::cout << colorBlue
+	      << "--- LINK SUMMARY: CruID=" << link.second->CruID << " FeeID=" << link.second->FeeID
+	      << std::endl;
+    link.second->Decoder->checkSummary();
+  }
+}
+
+}}
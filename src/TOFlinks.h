@@ -0,0 +1,83 @@
+#ifndef _TOF_LINKS_H_
+#define _TOF_LINKS_H_
+
+#include <map>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "TOFdecomp.h"
+
+namespace tof {
+namespace data {
+
+/**
+ ** per-link decoder for CRU files interleaving many links
+ ** pages are routed by RDH CruID/FeeID to a TOFdecomp instance owned
+ ** by the link, each link is bound to one worker so that its pages
+ ** are decoded in order while different links run concurrently
+ **/
+
+class TOFlinks {
+
+public:
+
+  TOFlinks(int nWorkers);
+  ~TOFlinks();
+
+  bool init(const TOFdecomp &master);
+  /** write per-link output files named <prefix>.cru<CruID>.fee<FeeID> **/
+  void setLinkOutput(std::string prefix) { mLinkOutput = prefix; };
+  /** decode all pages from the master input, write to the master output **/
+  bool run(TOFdecomp &master);
+  void checkSummary();
+
+private:
+
+  struct Link {
+    uint32_t   CruID;
+    uint32_t   FeeID;
+    int        Worker;
+    TOFdecomp *Decoder;
+    std::vector<struct iovec> Output;
+  };
+
+  struct Task {
+    Link *Target;
+    long  Page;
+  };
+
+  Link *getLink(const char *page);
+  void worker(int iworker);
+
+  int         mNWorkers;
+  int         mDRM = -1;
+  int         mCheckLevel = TOFdecomp::kCheckFull;
+  TOFmetrics *mMetrics = nullptr;
+  bool        mLatency = false;
+  std::string mLinkOutput;
+
+  std::map<uint32_t, Link *> mLinks;
+  std::vector<std::thread>   mThreads;
+
+  /** current buffer of pages, their output range in the worker segments and the per-worker tasks **/
+  std::vector<const char *>        mPages;
+  std::vector<long>                mPageBegin;
+  std::vector<long>                mPageEnd;
+  std::vector<Link *>              mPageLinks;
+  std::vector<std::vector<Task> >  mTasks;
+  std::vector<TOFsegments>         mOutputs;
+
+  std::mutex              mMutex;
+  std::condition_variable mStartCondition;
+  std::condition_variable mDoneCondition;
+  long                    mGeneration = 0;
+  int                     mPending    = 0;
+  bool                    mStop       = false;
+
+};
+
+}}
+
+#endif /** _TOF_LINKS_H_ **/
@@ -0,0 +1,317 @@
+#include "TOFmetrics.h"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define colorRed     "\033[1;31m"
+#define colorBlue    "\033[1;34m"
+
+namespace tof {
+namespace data {
+
+namespace {
+
+  struct Field_t {
+    const char *Name;
+    const char *Help;
+    size_t      Offset;
+  };
+
+  const Field_t sDRMFields[] = {
+    { "tof_drm_headers_total",              "DRM headers",                               offsetof(counters::DRMCounters_t, Headers) },
+    { "tof_drm_event_words_mismatch_total", "DRM events with an event words mismatch",   offsetof(counters::DRMCounters_t, EventWordsMismatch) },
+    { "tof_drm_cbit_total",                 "DRM events with the C bit set",             offsetof(counters::DRMCounters_t, CBit) },
+    { "tof_drm_fault_total",                "DRM events with a fault",                   offsetof(counters::DRMCounters_t, Fault) },
+    { "tof_drm_rtobit_total",               "DRM events with the RTO bit set",           offsetof(counters::DRMCounters_t, RTOBit) }
+  };
+
+  const Field_t sTRMFields[] = {
+    { "tof_trm_headers_total",                "TRM headers",                             offsetof(counters::TRMCounters_t, Headers) },
+    { "tof_trm_empty_total",                  "empty TRMs",                              offsetof(counters::TRMCounters_t, Empty) },
+    { "tof_trm_event_counter_mismatch_total", "TRMs with an event counter mismatch",     offsetof(counters::TRMCounters_t, EventCounterMismatch) },
+    { "tof_trm_event_words_mismatch_total",   "TRMs with an event words mismatch",       offsetof(counters::TRMCounters_t, EventWordsMismatch) },
+    { "tof_trm_ebit_total",                   "TRMs with the E bit set",                 offsetof(counters::TRMCounters_t, EBit) }
+  };
+
+  const Field_t sTRMChainFields[] = {
+    { "tof_trm_chain_headers_total",                "TRM chain headers",                          offsetof(counters::TRMChainCounters_t, Headers) },
+    { "tof_trm_chain_event_counter_mismatch_total", "TRM chains with an event counter mismatch",  offsetof(counters::TRMChainCounters_t, EventCounterMismatch) },
+    { "tof_trm_chain_bad_status_total",             "TRM chains with a bad status",               offsetof(counters::TRMChainCounters_t, BadStatus) },
+    { "tof_trm_chain_bunch_id_mismatch_total",      "TRM chains with a bunch ID mismatch",        offsetof(counters::TRMChainCounters_t, BunchIDMismatch) },
+    { "tof_trm_chain_tdc_error_total",              "TRM chains with TDC errors",                 offsetof(counters::TRMChainCounters_t, TDCerror) }
+  };
+
+  inline uint32_t
+  fieldValue(const void *counters, const Field_t &field)
+  {
+    return *reinterpret_cast<const uint32_t *>(reinterpret_cast<const char *>(counters) + field.Offset);
+  }
+
+  void
+  family(std::ostringstream &text, const char *name, const char *help, const char *type)
+  {
+    text << "# HELP " << name << " " << help << "\n"
+	 << "# TYPE " << name << " " << type << "\n";
+  }
+
+  template <typename T>
+  void
+  metric(std::ostringstream &text, const char *name, const char *help, const char *type, T value)
+  {
+    family(text, name, help, type);
+    text << name << " " << value << "\n";
+  }
+
+}
+
+void
+TOFmetrics::Snapshot_t::add(const Snapshot_t &other)
+{
+  Pages       += other.Pages;
+  BytesIn     += other.BytesIn;
+  BytesOut    += other.BytesOut;
+  Events      += other.Events;
+  Checked     += other.Checked;
+  Resyncs     += other.Resyncs;
+  ResyncBytes += other.ResyncBytes;
+  /** the counters are plain structures of 32-bit words **/
+  auto sum = [](void *to, const void *from, size_t size) {
+    for (size_t iword = 0; iword < size / sizeof(uint32_t); ++iword)
+      reinterpret_cast<uint32_t *>(to)[iword] += reinterpret_cast<const uint32_t *>(from)[iword];
+  };
+  sum(&DRM, &other.DRM, sizeof(DRM));
+  sum(TRM, other.TRM, sizeof(TRM));
+  sum(TRMChain, other.TRMChain, sizeof(TRMChain));
+}
+
+TOFmetrics::TOFmetrics()
+{
+  mSlots = new Slot_t[kMaxSlots];
+  for (int islot = 0; islot < kMaxSlots; ++islot) {
+    mSlots[islot].Request.store(false);
+    mSlots[islot].Data = {};
+  }
+  mCache.assign(kMaxSlots, Snapshot_t());
+}
+
+TOFmetrics::~TOFmetrics()
+{
+  mStop = true;
+  if (mThread.joinable()) mThread.join();
+  if (mListenFD != -1) ::close(mListenFD);
+  delete [] mSlots;
+}
+
+bool
+TOFmetrics::isHTTP(std::string name)
+{
+  return name.compare(0, 5, "http:") == 0;
+}
+
+bool
+TOFmetrics::start(std::string name)
+{
+  if (mInterval <= 0.) {
+    std::cerr << colorRed
+	      << "-E- invalid metrics interval: " << mInterval << " s"
+	      << std::endl;
+    return true;
+  }
+  mName = name;
+  if (isHTTP(name)) {
+    int port = std::atoi(name.c_str() + 5);
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int reuse = 1;
+    mListenFD = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (port <= 0 || port > 65535 || mListenFD == -1 ||
+	setsockopt(mListenFD, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == -1 ||
+	::bind(mListenFD, (struct sockaddr *)&address, sizeof(address)) == -1 ||
+	::listen(mListenFD, 4) == -1) {
+      std::cerr << colorRed
+		<< "-E- cannot serve metrics on " << name << ": " << std::strerror(errno)
+		<< std::endl;
+      if (mListenFD != -1) ::close(mListenFD);
+      mListenFD = -1;
+      return true;
+    }
+    std::cout << colorBlue
+	      << "--- METRICS: http://127.0.0.1:" << port << "/metrics every " << mInterval << " s"
+	      << "\033[0m" << std::endl;
+  }
+  else {
+    std::cout << colorBlue
+	      << "--- METRICS: " << name << " every " << mInterval << " s"
+	      << "\033[0m" << std::endl;
+  }
+  mStart = std::chrono::steady_clock::now();
+  mThread = std::thread(&TOFmetrics::loop, this);
+  return false;
+}
+
+void
+TOFmetrics::stop(const Snapshot_t &final)
+{
+  if (!mThread.joinable()) return;
+  mStop = true;
+  mThread.join();
+  /** the final counters are averaged over the whole run **/
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - mStart;
+  mLast = {};
+  render(final, elapsed.count(), elapsed.count());
+  output();
+}
+
+int
+TOFmetrics::attach()
+{
+  int slot = mNSlots.fetch_add(1);
+  if (slot < kMaxSlots) return slot;
+  std::cout << "\033[1;33m"
+	    << "-W- no metrics slot left, decoder not exported"
+	    << "\033[0m" << std::endl;
+  return -1;
+}
+
+void
+TOFmetrics::publish(int slot, const Snapshot_t &snapshot)
+{
+  mSlots[slot].Data = snapshot;
+  mSlots[slot].Request.store(false, std::memory_order_release);
+}
+
+void
+TOFmetrics::collect(Snapshot_t &total)
+{
+  /** a slot that did not answer yet keeps its previous counters **/
+  total = {};
+  int nslots = mNSlots.load();
+  if (nslots > kMaxSlots) nslots = kMaxSlots;
+  for (int islot = 0; islot < nslots; ++islot) {
+    auto &slot = mSlots[islot];
+    if (!slot.Request.load(std::memory_order_acquire)) {
+      mCache[islot] = slot.Data;
+      slot.Request.store(true, std::memory_order_release);
+    }
+    total.add(mCache[islot]);
+  }
+}
+
+void
+TOFmetrics::loop()
+{
+  auto last = std::chrono::steady_clock::now();
+  auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(mInterval));
+  auto next = last;
+  while (!mStop) {
+    auto now = std::chrono::steady_clock::now();
+    if (now >= next) {
+      Snapshot_t total;
+      collect(total);
+      std::chrono::duration<double> elapsed = now - last;
+      std::chrono::duration<double> uptime = now - mStart;
+      render(total, elapsed.count(), uptime.count());
+      mLast = total;
+      last = now;
+      next = now + interval;
+      output();
+      continue;
+    }
+    /** wait for the next interval, serving requests and watching for stop **/
+    int timeout = std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count() + 1;
+    struct pollfd listen = { mListenFD, POLLIN, 0 };
+    if (poll(&listen, mListenFD == -1 ? 0 : 1, std::min(timeout, 100)) > 0) serve();
+  }
+}
+
+void
+TOFmetrics::render(const Snapshot_t &total, double interval, double elapsed)
+{
+  std::ostringstream text;
+  double rate = interval > 0. ? 1. / interval : 0.;
+  metric(text, "tof_uptime_seconds", "Seconds since the metrics were started", "gauge", elapsed);
+  metric(text, "tof_pages_total", "Raw data pages decoded", "counter", total.Pages);
+  metric(text, "tof_input_bytes_total", "Raw data bytes decoded", "counter", total.BytesIn);
+  metric(text, "tof_output_bytes_total", "Compressed bytes encoded", "counter", total.BytesOut);
+  metric(text, "tof_events_total", "Events decoded", "counter", total.Events);
+  metric(text, "tof_checked_events_total", "Events checked", "counter", total.Checked);
+  metric(text, "tof_resyncs_total", "Resynchronisations after corrupted data", "counter", total.Resyncs);
+  metric(text, "tof_resync_bytes_total", "Bytes skipped by resynchronisations", "counter", total.ResyncBytes);
+  metric(text, "tof_input_bytes_per_second", "Raw data bytes decoded per second over the last interval", "gauge", (total.BytesIn - mLast.BytesIn) * rate);
+  metric(text, "tof_output_bytes_per_second", "Compressed bytes encoded per second over the last interval", "gauge", (total.BytesOut - mLast.BytesOut) * rate);
+  metric(text, "tof_events_per_second", "Events decoded per second over the last interval", "gauge", (total.Events - mLast.Events) * rate);
+  metric(text, "tof_compression_factor", "Raw data bytes per compressed byte", "gauge", total.BytesOut > 0 ? (double)total.BytesIn / total.BytesOut : 0.);
+
+  for (auto &field : sDRMFields)
+    metric(text, field.Name, field.Help, "counter", fieldValue(&total.DRM, field));
+  for (auto &field : sTRMFields) {
+    family(text, field.Name, field.Help, "counter");
+    for (int itrm = 0; itrm < 10; ++itrm)
+      text << field.Name << "{slot=\"" << itrm + 3 << "\"} " << fieldValue(&total.TRM[itrm], field) << "\n";
+  }
+  for (auto &field : sTRMChainFields) {
+    family(text, field.Name, field.Help, "counter");
+    for (int itrm = 0; itrm < 10; ++itrm)
+      for (int ichain = 0; ichain < 2; ++ichain)
+	text << field.Name << "{slot=\"" << itrm + 3 << "\",chain=\"" << (char)('a' + ichain) << "\"} "
+	     << fieldValue(&total.TRMChain[itrm][ichain], field) << "\n";
+  }
+  mText = text.str();
+}
+
+bool
+TOFmetrics::output()
+{
+  if (mListenFD != -1) return false;
+  /** written aside and renamed, a reader never sees a partial file **/
+  std::string temporary = mName + ".tmp";
+  std::ofstream file(temporary, std::ios::trunc);
+  file << mText;
+  file.close();
+  if (!file || std::rename(temporary.c_str(), mName.c_str()) != 0) {
+    std::cerr << colorRed
+	      << "-E- cannot write metrics to " << mName
+	      << std::endl;
+    return true;
+  }
+  return false;
+}
+
+void
+TOFmetrics::serve()
+{
+  int client;
+  while ((client = ::accept4(mListenFD, nullptr, nullptr, SOCK_CLOEXEC)) != -1) {
+    /** the request is read and ignored, every path gets the metrics **/
+    struct timeval timeout = { 0, 100000 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    char request[4096];
+    if (::recv(client, request, sizeof(request), 0) > 0) {
+      std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+	+ std::to_string(mText.size()) + "\r\nConnection: close\r\n\r\n" + mText;
+      for (size_t sent = 0; sent < response.size(); ) {
+	auto n = ::send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+	if (n <= 0) break;
+	sent += n;
+      }
+    }
+    ::close(client);
+  }
+}
+
+}}
@@ -0,0 +1,94 @@
+#ifndef _TOF_METRICS_H_
+#define _TOF_METRICS_H_
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "dataFormat.h"
+
+namespace tof {
+namespace data {
+
+/**
+ ** live metrics of a running decoder
+ ** each decoder owns a slot; at every interval the exporter thread asks
+ ** the slots for fresh counters and each decoder answers at its next page
+ ** with a copy of its counters, the decoders pay one load per page and
+ ** never wait; the sum over the slots is published in the Prometheus text
+ ** format to a file, replaced atomically, or served on a local HTTP port
+ ** (http:<port>)
+ **/
+
+class TOFmetrics {
+
+public:
+
+  struct Snapshot_t {
+    long Pages;
+    long BytesIn;
+    long BytesOut;
+    long Events;
+    long Checked;
+    long Resyncs;
+    long ResyncBytes;
+    counters::DRMCounters_t      DRM;
+    counters::TRMCounters_t      TRM[10];
+    counters::TRMChainCounters_t TRMChain[10][2];
+    void add(const Snapshot_t &other);
+  };
+
+  TOFmetrics();
+  ~TOFmetrics();
+
+  void setInterval(double val) { mInterval = val; };
+
+  bool start(std::string name);
+  /** publish the final counters and stop the exporter **/
+  void stop(const Snapshot_t &final);
+  bool isRunning() const { return mThread.joinable(); };
+
+  /** one slot per decoder, -1 if there are no slots left **/
+  int attach();
+  inline bool requested(int slot) const { return mSlots[slot].Request.load(std::memory_order_acquire); };
+  void publish(int slot, const Snapshot_t &snapshot);
+
+  /** names in the http:<port> form are served on the loopback interface **/
+  static bool isHTTP(std::string name);
+
+private:
+
+  struct Slot_t {
+    alignas(64) std::atomic<bool> Request;
+    Snapshot_t                    Data;
+  };
+
+  static const int kMaxSlots = 256;
+
+  void loop();
+  void collect(Snapshot_t &total);
+  void render(const Snapshot_t &total, double interval, double elapsed);
+  bool output();
+  void serve();
+
+  std::string mName;
+  double      mInterval = 1.;
+  int         mListenFD = -1;
+  std::thread mThread;
+  std::atomic<bool> mStop{false};
+
+  Slot_t           *mSlots;
+  std::atomic<int>  mNSlots{0};
+
+  /** exporter side **/
+  std::vector<Snapshot_t> mCache;
+  Snapshot_t  mLast = {};
+  std::string mText;
+  std::chrono::steady_clock::time_point mStart;
+
+};
+
+}}
+
+#endif /** _TOF_METRICS_H_ **/
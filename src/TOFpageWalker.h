@@ -0,0 +1,65 @@
+#ifndef _TOF_PAGEWALKER_H_
+#define _TOF_PAGEWALKER_H_
+
+#include <cstdint>
+#include "dataFormat.h"
+
+namespace tof {
+namespace data {
+
+/**
+ ** walks consecutive RDH pages in a memory region
+ ** the next page is found with RDHWord0.OffsetNewPacket, hence
+ ** pages of any size can follow each other in the same buffer
+ **/
+
+class TOFpageWalker {
+
+public:
+
+  TOFpageWalker() {};
+  TOFpageWalker(const char *begin, const char *end) { reset(begin, end); };
+
+  void reset(const char *begin, const char *end) { mNext = begin; mEnd = end; mPage = nullptr; mPageSize = 0; mError = false; };
+
+  /** move to the next complete page, returns true if there is none **/
+  inline bool next() {
+    if (mEnd - mNext < RDHSize) return true;
+    auto rdh = reinterpret_cast<const raw::RDHWord0_t *>(mNext);
+    long size = rdh->OffsetNewPacket;
+    if (size < RDHSize || size < rdh->MemorySize) {
+      mError = true;
+      return true;
+    }
+    if (mEnd - mNext < size) return true;
+    mPage = mNext;
+    mPageSize = size;
+    mNext += size;
+    return false;
+  };
+
+  const char *page() const { return mPage; };
+  long pageSize() const { return mPageSize; };
+  /** first byte after the last complete page **/
+  const char *remainder() const { return mNext; };
+  const char *end() const { return mEnd; };
+  /** the RDH at remainder() is not a valid page header **/
+  bool error() const { return mError; };
+
+  static const long RDHSize = 64;
+  /** OffsetNewPacket is 16 bits, no page can be larger than this **/
+  static const long MaxPageSize = 65535;
+
+private:
+
+  const char *mNext     = nullptr;
+  const char *mEnd      = nullptr;
+  const char *mPage     = nullptr;
+  long        mPageSize = 0;
+  bool        mError    = false;
+
+};
+
+}}
+
+#endif /** _TOF_PAGEWALKER_H_ **/
@@ -0,0 +1,129 @@
+#include "TOFparallel.h"
+#include <iostream>
+#include <algorithm>
+
+#define colorRed     "\033[1;31m"
+#define colorBlue    "\033[1;34m"
+
+namespace tof {
+namespace data {
+
+TOFparallel::TOFparallel(int nWorkers, int nPagesPerJob) :
+  mNWorkers(nWorkers),
+  mNPagesPerJob(nPagesPerJob)
+{
+}
+
+TOFparallel::~TOFparallel()
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStop = true;
+  }
+  mQueueCondition.notify_all();
+  for (auto &thread : mThreads) thread.join();
+  for (auto decoder : mDecoders) delete decoder;
+}
+
+bool
+TOFparallel::init(const TOFdecomp &master)
+{
+  if (mNWorkers < 1 || mNPagesPerJob < 1) {
+    std::cerr << colorRed
+	      << "-E- invalid parallel configuration: " << mNWorkers << " workers, " << mNPagesPerJob << " pages per job"
+	      << std::endl;
+    return true;
+  }
+  std::cout << colorBlue
+	    << "--- INITIALISE PARALLEL DECODER: " << mNWorkers << " workers"
+	    << std::endl;
+  for (int iworker = 0; iworker < mNWorkers; ++iworker) {
+    auto decoder = new TOFdecomp;
+    decoder->setDRM(master.getDRM());
+    decoder->setCheckLevel(master.getCheckLevel());
+    decoder->setMetrics(master.getMetrics());
+    decoder->setLatency(master.hasLatency());
+    if (decoder->init()) return true;
+    mDecoders.push_back(decoder);
+  }
+  /** a few jobs per worker keep the pool busy while the oldest is written **/
+  mJobs.resize(4 * mNWorkers);
+  for (int iworker = 0; iworker < mNWorkers; ++iworker)
+    mThreads.push_back(std::thread(&TOFparallel::worker, this, iworker));
+  return false;
+}
+
+void
+TOFparallel::worker(int iworker)
+{
+  auto decoder = mDecoders[iworker];
+  while (true) {
+    Job *job;
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mQueueCondition.wait(lock, [this] { return mStop || !mQueue.empty(); });
+      if (mQueue.empty()) return;
+      job = mQueue.front();
+      mQueue.pop_front();
+    }
+    for (auto page : job->Pages)
+      decoder->decodePage(page, job->Output);
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      job->Done = true;
+    }
+    mDoneCondition.notify_all();
+  }
+}
+
+void
+TOFparallel::submit(Job &job)
+{
+  job.Output.clear();
+  job.Done = false;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mQueue.push_back(&job);
+  }
+  mQueueCondition.notify_one();
+  mSubmitted++;
+}
+
+bool
+TOFparallel::writeNext(TOFdecomp &master)
+{
+  /** reorder stage: always wait for the oldest job **/
+  auto &job = mJobs[mWritten % mJobs.size()];
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCondition.wait(lock, [&job] { return job.Done; });
+  }
+  mWritten++;
+  if (job.Output.empty()) return false;
+  return master.write(job.Output);
+}
+
+bool
+TOFparallel::run(TOFdecomp &master)
+{
+  std::vector<const char *> pages;
+  while (!master.readPages(pages)) {
+    for (size_t ipage = 0; ipage < pages.size(); ipage += mNPagesPerJob) {
+      if (mSubmitted - mWritten == (long)mJobs.size() && writeNext(master)) return true;
+      auto &job = mJobs[mSubmitted % mJobs.size()];
+      auto last = std::min(pages.size(), ipage + mNPagesPerJob);
+      job.Pages.assign(pages.begin() + ipage, pages.begin() + last);
+      submit(job);
+    }
+    /** pages are only valid until the next read **/
+    while (mWritten < mSubmitted)
+      if (writeNext(master)) return true;
+  }
+
+  /** merge the worker counters for the check summary **/
+  for (auto decoder : mDecoders)
+    master.addCounters(*decoder);
+  return false;
+}
+
+}}
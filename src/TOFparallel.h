@@ -0,0 +1,65 @@
+#ifndef _TOF_PARALLEL_H_
+#define _TOF_PARALLEL_H_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "TOFdecomp.h"
+
+namespace tof {
+namespace data {
+
+/**
+ ** page-parallel decoder
+ ** pages are handed out in jobs to a pool of workers, each owning
+ ** a TOFdecomp instance, and the output of the jobs is written back
+ ** in input order so that it is identical to a single-threaded run
+ **/
+
+class TOFparallel {
+
+public:
+
+  TOFparallel(int nWorkers, int nPagesPerJob = 64);
+  ~TOFparallel();
+
+  bool init(const TOFdecomp &master);
+  /** decode all pages from the master input, write to the master output **/
+  bool run(TOFdecomp &master);
+
+private:
+
+  struct Job {
+    std::vector<const char *> Pages;
+    TOFsegments               Output;
+    bool                      Done;
+  };
+
+  void worker(int iworker);
+  void submit(Job &job);
+  bool writeNext(TOFdecomp &master);
+
+  int mNWorkers;
+  int mNPagesPerJob;
+
+  std::vector<TOFdecomp *>  mDecoders;
+  std::vector<std::thread>  mThreads;
+
+  /** ring of jobs in flight, indexed by sequence number **/
+  std::vector<Job> mJobs;
+  long             mSubmitted = 0;
+  long             mWritten   = 0;
+
+  std::deque<Job *>       mQueue;
+  std::mutex              mMutex;
+  std::condition_variable mQueueCondition;
+  std::condition_variable mDoneCondition;
+  bool                    mStop = false;
+
+};
+
+}}
+
+#endif /** _TOF_PARALLEL_H_ **/
@@ -0,0 +1,183 @@
+#include "TOFpipeline.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <pthread.h>
+#include <sched.h>
+
+#define colorRed     "\033[1;31m"
+#define colorYellow  "\033[1;33m"
+#define colorBlue    "\033[1;34m"
+
+namespace tof {
+namespace data {
+
+namespace {
+
+  const char *sStageName[TOFpipeline::kNStages] = { "read", "decode", "write" };
+
+}
+
+TOFpipeline::TOFpipeline(int depth) :
+  mDepth(depth)
+{
+}
+
+TOFpipeline::~TOFpipeline()
+{
+  if (mDecoder) delete mDecoder;
+}
+
+bool
+TOFpipeline::init(const TOFdecomp &master)
+{
+  if (mDepth < 2) {
+    std::cerr << colorRed
+	      << "-E- invalid pipeline depth: " << mDepth << " batches"
+	      << std::endl;
+    return true;
+  }
+  std::cout << colorBlue
+	    << "--- INITIALISE PIPELINE: " << mDepth << " batches in flight"
+	    << std::endl;
+  mDecoder = new TOFdecomp;
+  mDecoder->setDRM(master.getDRM());
+  mDecoder->setCheckLevel(master.getCheckLevel());
+  mDecoder->setMetrics(master.getMetrics());
+  mDecoder->setLatency(master.hasLatency());
+  if (mDecoder->init()) return true;
+  /** every queue can hold all batches, the free queue starts full **/
+  mBatches.resize(mDepth);
+  mFreeQueue.setCapacity(mDepth + 1);
+  mDecodeQueue.setCapacity(mDepth + 1);
+  mWriteQueue.setCapacity(mDepth + 1);
+  for (auto &batch : mBatches)
+    mFreeQueue.tryPush(&batch);
+  return false;
+}
+
+void
+TOFpipeline::pin(int stage)
+{
+  if (stage >= (int)mPinning.size() || mPinning[stage] < 0) return;
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(mPinning[stage], &cpus);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+    std::cout << colorYellow
+	      << "-W- cannot pin " << sStageName[stage] << " stage to core " << mPinning[stage]
+	      << "\033[0m" << std::endl;
+  }
+}
+
+void
+TOFpipeline::reader(TOFdecomp &master)
+{
+  pin(kRead);
+  auto &stage = mStages[kRead];
+  auto start = std::chrono::steady_clock::now();
+  std::vector<const char *> pages;
+  while (!mError && !master.readPages(pages)) {
+    Batch *batch;
+    stage.WaitIn += mFreeQueue.pop(batch);
+    /** the pages are valid until the next read, they are copied into the batch **/
+    batch->Data.clear();
+    batch->Pages.clear();
+    for (auto page : pages) {
+      long size = reinterpret_cast<const raw::RDHWord0_t *>(page)->OffsetNewPacket;
+      batch->Pages.push_back(batch->Data.size());
+      batch->Data.insert(batch->Data.end(), page, page + size);
+    }
+    stage.Batches++;
+    stage.Bytes += batch->Data.size();
+    stage.WaitOut += mDecodeQueue.push(batch);
+  }
+  stage.WaitOut += mDecodeQueue.push(nullptr);
+  stage.Wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void
+TOFpipeline::decoder()
+{
+  pin(kDecode);
+  auto &stage = mStages[kDecode];
+  auto start = std::chrono::steady_clock::now();
+  while (true) {
+    Batch *batch;
+    stage.WaitIn += mDecodeQueue.pop(batch);
+    if (!batch) break;
+    batch->Output.clear();
+    for (auto offset : batch->Pages)
+      mDecoder->decodePage(batch->Data.data() + offset, batch->Output);
+    stage.Batches++;
+    stage.Bytes += batch->Data.size();
+    stage.WaitOut += mWriteQueue.push(batch);
+  }
+  stage.WaitOut += mWriteQueue.push(nullptr);
+  stage.Wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void
+TOFpipeline::writer(TOFdecomp &master)
+{
+  pin(kWrite);
+  auto &stage = mStages[kWrite];
+  auto start = std::chrono::steady_clock::now();
+  while (true) {
+    Batch *batch;
+    stage.WaitIn += mWriteQueue.pop(batch);
+    if (!batch) break;
+    /** after an error the batches still go round until the reader stops **/
+    if (!mError && !batch->Output.empty() && master.write(batch->Output))
+      mError = true;
+    stage.Batches++;
+    stage.Bytes += batch->Output.size();
+    stage.WaitOut += mFreeQueue.push(batch);
+  }
+  stage.Wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool
+TOFpipeline::run(TOFdecomp &master)
+{
+  std::thread readThread(&TOFpipeline::reader, this, std::ref(master));
+  std::thread decodeThread(&TOFpipeline::decoder, this);
+  std::thread writeThread(&TOFpipeline::writer, this, std::ref(master));
+  readThread.join();
+  decodeThread.join();
+  writeThread.join();
+
+  /** merge the decoder counters for the check summary **/
+  master.addCounters(*mDecoder);
+  return mError;
+}
+
+void
+TOFpipeline::summary() const
+{
+  std::cout << colorBlue
+	    << "--- PIPELINE SUMMARY"
+	    << "\033[0m" << std::endl;
+  int slowest = 0;
+  double busy[kNStages];
+  for (int istage = 0; istage < kNStages; ++istage) {
+    auto &stage = mStages[istage];
+    busy[istage] = stage.Wall - stage.WaitIn - stage.WaitOut;
+    if (busy[istage] > busy[slowest]) slowest = istage;
+  }
+  printf("\n");
+  printf("    %-8s %5s %9s %12s %10s %10s %10s %8s \n", "stage", "core", "batches", "bytes", "busy s", "wait-in s", "wait-out s", "busy %");
+  for (int istage = 0; istage < kNStages; ++istage) {
+    auto &stage = mStages[istage];
+    int core = istage < (int)mPinning.size() ? mPinning[istage] : -1;
+    printf("    %-8s ", sStageName[istage]);
+    if (core >= 0) printf("%5d ", core);
+    else printf("%5s ", "-");
+    printf("%9ld %12ld %10.3f %10.3f %10.3f %8.1f %s\n", stage.Batches, stage.Bytes, busy[istage], stage.WaitIn, stage.WaitOut,
+	   stage.Wall > 0. ? 100. * busy[istage] / stage.Wall : 0., istage == slowest ? "<- slowest" : "");
+  }
+  printf("\n");
+}
+
+}}
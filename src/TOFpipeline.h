@@ -0,0 +1,83 @@
+#ifndef _TOF_PIPELINE_H_
+#define _TOF_PIPELINE_H_
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "TOFdecomp.h"
+#include "TOFqueue.h"
+
+namespace tof {
+namespace data {
+
+/**
+ ** pipelined decoder
+ ** reading, decoding and writing run as stages on their own threads,
+ ** connected by lock-free single-producer/single-consumer queues of
+ ** batch descriptors; a fixed number of batches circulates, hence a slow
+ ** stage stalls the stages in front of it (back-pressure), and each stage
+ ** reports how busy it was so that the slowest one is visible
+ **/
+
+class TOFpipeline {
+
+public:
+
+  enum EStage_t {
+    kRead,
+    kDecode,
+    kWrite,
+    kNStages
+  };
+
+  TOFpipeline(int depth = 4);
+  ~TOFpipeline();
+
+  /** core of each stage, -1 is not pinned **/
+  void setPinning(const std::vector<int> &cpus) { mPinning = cpus; };
+
+  bool init(const TOFdecomp &master);
+  /** decode all pages from the master input, write to the master output **/
+  bool run(TOFdecomp &master);
+  void summary() const;
+
+private:
+
+  /** pages copied out of the master read buffer and their output **/
+  struct Batch {
+    std::vector<char> Data;
+    std::vector<long> Pages;    // page offsets in Data
+    TOFsegments       Output;
+  };
+
+  struct Stage {
+    long   Batches = 0;
+    long   Bytes   = 0;
+    double Wall    = 0.;
+    double WaitIn  = 0.;        // waiting for work
+    double WaitOut = 0.;        // waiting for room downstream
+  };
+
+  void reader(TOFdecomp &master);
+  void decoder();
+  void writer(TOFdecomp &master);
+  void pin(int stage);
+
+  int              mDepth;
+  std::vector<int> mPinning;
+  TOFdecomp       *mDecoder = nullptr;
+  std::vector<Batch> mBatches;
+
+  /** free batches go back from the writer to the reader, nullptr ends the stream **/
+  TOFqueue<Batch *> mFreeQueue;
+  TOFqueue<Batch *> mDecodeQueue;
+  TOFqueue<Batch *> mWriteQueue;
+
+  Stage             mStages[kNStages];
+  std::atomic<bool> mError{false};
+
+};
+
+}}
+
+#endif /** _TOF_PIPELINE_H_ **/
@@ -0,0 +1,112 @@
+#include "TOFprobe.h"
+
+#ifdef TOF_PROBES
+
+#include <iostream>
+#include <cstdio>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#define colorBlue    "\033[1;34m"
+
+namespace tof {
+namespace data {
+
+__thread TOFprobe::Local_t TOFprobe::sLocal;
+
+namespace {
+
+  const char *sStageName[TOFprobe::kNStages] = {
+    "event", "  drm header", "  chain", "  spider", "  frames", "  check", "  trailer"
+  };
+  const char *sStageUnit[TOFprobe::kNStages] = {
+    "raw", "raw", "raw", "hits", "out", "diag", "out"
+  };
+
+  std::mutex                     sMutex;
+  std::vector<TOFprobe::Local_t *> sLive;
+  TOFprobe::Counter_t            sRetired[TOFprobe::kNStages] = {};
+
+  /** time-stamp counter and steady clock at start-up, to calibrate the counter rate **/
+  struct Origin_t {
+    uint64_t                              Cycles = __rdtsc();
+    std::chrono::steady_clock::time_point Time   = std::chrono::steady_clock::now();
+  } sOrigin;
+
+  /** keeps the counters of a thread when it exits **/
+  struct Retire_t {
+    TOFprobe::Local_t *Local = nullptr;
+    ~Retire_t() {
+      if (!Local) return;
+      std::lock_guard<std::mutex> lock(sMutex);
+      for (int istage = 0; istage < TOFprobe::kNStages; ++istage) {
+	sRetired[istage].Calls  += Local->Stage[istage].Calls;
+	sRetired[istage].Cycles += Local->Stage[istage].Cycles;
+	sRetired[istage].Words  += Local->Stage[istage].Words;
+      }
+      sLive.erase(std::remove(sLive.begin(), sLive.end(), Local), sLive.end());
+    };
+  };
+  thread_local Retire_t sRetire;
+
+}
+
+void
+TOFprobe::enroll()
+{
+  std::lock_guard<std::mutex> lock(sMutex);
+  sLocal.Enrolled = true;
+  sLive.push_back(&sLocal);
+  sRetire.Local = &sLocal;
+}
+
+void
+TOFprobe::report()
+{
+  Counter_t total[kNStages] = {};
+  {
+    std::lock_guard<std::mutex> lock(sMutex);
+    for (int istage = 0; istage < kNStages; ++istage) {
+      total[istage] = sRetired[istage];
+      for (auto local : sLive) {
+	total[istage].Calls  += local->Stage[istage].Calls;
+	total[istage].Cycles += local->Stage[istage].Cycles;
+	total[istage].Words  += local->Stage[istage].Words;
+      }
+    }
+  }
+
+  /** counter rate since start-up and cost of an empty probe **/
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - sOrigin.Time;
+  double ghz = (__rdtsc() - sOrigin.Cycles) / elapsed.count() / 1.e9;
+  uint64_t overhead = ~0ull;
+  for (int i = 0; i < 1000; ++i) {
+    unsigned int aux;
+    auto stamp = start(0);
+    overhead = std::min<uint64_t>(overhead, __rdtscp(&aux) - stamp.Cycles);
+  }
+
+  std::cout << colorBlue
+	    << "--- PROBE SUMMARY: time-stamp counter at " << ghz << " GHz, " << overhead << " cycles per empty probe"
+	    << "\033[0m" << std::endl;
+  printf("\n");
+  printf("    %-12s %12s %14s %5s %10s %12s %12s %8s \n", "stage", "calls", "words", "unit", "Mcycles", "cycles/call", "cycles/word", "share %");
+  double eventCycles = total[kEvent].Cycles;
+  for (int istage = 0; istage < kNStages; ++istage) {
+    auto &counter = total[istage];
+    printf("    %-12s %12lu %14lu %5s %10.1f ", sStageName[istage], counter.Calls, counter.Words, sStageUnit[istage], counter.Cycles / 1.e6);
+    if (counter.Calls > 0) printf("%12.1f ", (double)counter.Cycles / counter.Calls);
+    else printf("%12s ", "-");
+    if (counter.Words > 0) printf("%12.2f ", (double)counter.Cycles / counter.Words);
+    else printf("%12s ", "-");
+    if (eventCycles > 0.) printf("%8.1f \n", 100. * counter.Cycles / eventCycles);
+    else printf("%8s \n", "-");
+  }
+  printf("\n");
+}
+
+}}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef _TOF_PROBE_H_
+#define _TOF_PROBE_H_
+
+/**
+ ** cycle-level probes of the hot paths
+ ** compiled in with -DTOF_PROBES (cmake -DENABLE_PROBES=ON), otherwise
+ ** the macros expand to nothing; a probe reads the time-stamp counter at
+ ** both ends of a stage and adds the cycles and a word count to counters
+ ** of the calling thread, the counters of all threads are merged in the
+ ** report at the end of the run
+ **
+ **   TOF_PROBE(stamp);                          declare, before any goto
+ **   TOF_PROBE_START(stamp, mark);              mark is a word position
+ **   TOF_PROBE_STOP(kStage, stamp, mark);       words += mark - start mark
+ **   TOF_PROBE_REPORT();
+ **/
+
+#ifdef TOF_PROBES
+
+#include <cstdint>
+#include <x86intrin.h>
+
+namespace tof {
+namespace data {
+
+class TOFprobe {
+
+public:
+
+  enum EStage_t {
+    kEvent,       // the whole event, raw words
+    kDRMHeader,   // DRM headers and crate header, raw words
+    kChain,       // one TRM chain, raw words
+    kSpider,      // one TRM, packed hits
+    kFrames,      // frame encoding of one TRM, output words
+    kCheck,       // event check, diagnostic words
+    kTrailer,     // crate trailer and diagnostics, output words
+    kNStages
+  };
+
+  struct Stamp_t {
+    uint64_t Cycles;
+    long     Mark;
+  };
+
+  struct Counter_t {
+    uint64_t Calls;
+    uint64_t Cycles;
+    uint64_t Words;
+  };
+
+  struct Local_t {
+    bool      Enrolled;
+    Counter_t Stage[kNStages];
+  };
+
+  /** the fence keeps earlier loads out of the measured stage **/
+  static inline Stamp_t start(long mark) {
+    _mm_lfence();
+    return { __rdtsc(), mark };
+  };
+
+  /** rdtscp waits for the stage to retire **/
+  static inline void stop(int stage, const Stamp_t &stamp, long mark) {
+    unsigned int aux;
+    uint64_t cycles = __rdtscp(&aux);
+    if (!sLocal.Enrolled) enroll();
+    auto &counter = sLocal.Stage[stage];
+    counter.Calls++;
+    counter.Cycles += cycles - stamp.Cycles;
+    counter.Words += mark - stamp.Mark;
+  };
+
+  /** merge the counters of all threads and print them **/
+  static void report();
+
+private:
+
+  static void enroll();
+
+  /** plain TLS without initialisation guard, zeroed for each thread **/
+  static __thread Local_t sLocal;
+
+};
+
+}}
+
+#define TOF_PROBE(stamp)                   tof::data::TOFprobe::Stamp_t stamp
+#define TOF_PROBE_START(stamp, mark)       stamp = tof::data::TOFprobe::start(mark)
+#define TOF_PROBE_STOP(stage, stamp, mark) tof::data::TOFprobe::stop(tof::data::TOFprobe::stage, stamp, mark)
+#define TOF_PROBE_REPORT()                 tof::data::TOFprobe::report()
+
+#else
+
+#define TOF_PROBE(stamp)
+#define TOF_PROBE_START(stamp, mark)
+#define TOF_PROBE_STOP(stage, stamp, mark)
+#define TOF_PROBE_REPORT()
+
+#endif
+
+#endif /** _TOF_PROBE_H_ **/
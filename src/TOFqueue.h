@@ -0,0 +1,99 @@
+#ifndef _TOF_QUEUE_H_
+#define _TOF_QUEUE_H_
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstddef>
+
+namespace tof {
+namespace data {
+
+/**
+ ** bounded lock-free single-producer/single-consumer queue
+ ** one thread pushes and one thread pops, the indices only grow and
+ ** each side keeps a cached copy of the other index on its own cache
+ ** line; the blocking calls wait while the queue is full (back-pressure
+ ** on the producer) or empty and return the time spent waiting
+ **/
+
+template <typename T>
+class TOFqueue {
+
+public:
+
+  TOFqueue(size_t capacity = 16) { setCapacity(capacity); };
+
+  /** not thread safe, call before the queue is used **/
+  void setCapacity(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    mSlots.assign(size, T());
+    mMask = size - 1;
+    mHead.store(0);
+    mTail.store(0);
+    mTailCache = mHeadCache = 0;
+  };
+
+  inline bool tryPush(const T &value) {
+    auto head = mHead.load(std::memory_order_relaxed);
+    if (head - mTailCache > mMask) {
+      mTailCache = mTail.load(std::memory_order_acquire);
+      if (head - mTailCache > mMask) return false;
+    }
+    mSlots[head & mMask] = value;
+    mHead.store(head + 1, std::memory_order_release);
+    return true;
+  };
+
+  inline bool tryPop(T &value) {
+    auto tail = mTail.load(std::memory_order_relaxed);
+    if (tail == mHeadCache) {
+      mHeadCache = mHead.load(std::memory_order_acquire);
+      if (tail == mHeadCache) return false;
+    }
+    value = mSlots[tail & mMask];
+    mTail.store(tail + 1, std::memory_order_release);
+    return true;
+  };
+
+  /** blocking push and pop, return the seconds spent waiting **/
+  double push(const T &value) {
+    if (tryPush(value)) return 0.;
+    auto start = std::chrono::steady_clock::now();
+    for (int iteration = 0; !tryPush(value); ++iteration) backoff(iteration);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  };
+
+  double pop(T &value) {
+    if (tryPop(value)) return 0.;
+    auto start = std::chrono::steady_clock::now();
+    for (int iteration = 0; !tryPop(value); ++iteration) backoff(iteration);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  };
+
+private:
+
+  /** spin shortly, then leave the core to the other side **/
+  static void backoff(int iteration) {
+    if (iteration < 64) __builtin_ia32_pause();
+    else if (iteration < 1024) std::this_thread::yield();
+    else std::this_thread::sleep_for(std::chrono::microseconds(20));
+  };
+
+  std::vector<T> mSlots;
+  size_t         mMask = 0;
+
+  /** producer side **/
+  alignas(64) std::atomic<size_t> mHead{0};
+  size_t                          mTailCache = 0;
+  /** consumer side **/
+  alignas(64) std::atomic<size_t> mTail{0};
+  size_t                          mHeadCache = 0;
+
+};
+
+}}
+
+#endif /** _TOF_QUEUE_H_ **/
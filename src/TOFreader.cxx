@@ -0,0 +1,212 @@
+#include "TOFreader.h"
+#include <iostream>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define colorRed     "\033[1;31m"
+#define colorYellow  "\033[1;33m"
+#define colorBlue    "\033[1;34m"
+
+namespace tof {
+namespace data {
+
+bool
+TOFreader::open(std::string name)
+{
+  close();
+  mFD = ::open(name.c_str(), O_RDONLY);
+  if (mFD == -1) {
+    std::cerr << colorRed
+	      << "-E- Cannot open input file: " << name
+	      << std::endl;
+    return true;
+  }
+  struct stat st;
+  if (fstat(mFD, &st) == -1 || st.st_size == 0) {
+    std::cerr << colorRed
+	      << "-E- Cannot stat input file or file is empty: " << name
+	      << std::endl;
+    close();
+    return true;
+  }
+  void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, mFD, 0);
+  if (map == MAP_FAILED) {
+    std::cerr << colorRed
+	      << "-E- Cannot map input file: " << name
+	      << std::endl;
+    close();
+    return true;
+  }
+  mMap = (char *)map;
+  mMapSize = st.st_size;
+  madvise(mMap, mMapSize, MADV_SEQUENTIAL);
+  madvise(mMap, mMapSize, MADV_WILLNEED);
+  setBuffer(mMap, mMapSize);
+  return false;
+}
+
+bool
+TOFreader::close()
+{
+  if (mFD == -1) return true;
+  if (mMap) munmap(mMap, mMapSize);
+  ::close(mFD);
+  mMap = nullptr;
+  mMapSize = 0;
+  mFD = -1;
+  setBuffer(nullptr, 0);
+  return false;
+}
+
+void
+TOFreader::setBuffer(const char *buffer, long size)
+{
+  mBegin = reinterpret_cast<const uint32_t *>(buffer);
+  mEnd = mBegin + size / 4;
+  mCrateHeader = mCrateTrailer = nullptr;
+  mFrames.clear();
+  mNumberOfHits = 0;
+  rewind();
+}
+
+bool
+TOFreader::next()
+{
+  mFrames.clear();
+  mNumberOfHits = 0;
+  if (mError || mEnd - mPointer < 3) return true;
+
+  /** crate header and orbit **/
+  if (!IS_CRATE_HEADER(*mPointer)) {
+    std::cout << colorRed
+	      << "-E- expected crate header at byte " << offset()
+	      << std::endl;
+    mError = true;
+    return true;
+  }
+  auto header = mPointer;
+  mPointer += 2;
+
+  /** frames, until the crate trailer **/
+  while (mPointer < mEnd && IS_FRAME_HEADER(*mPointer)) {
+    auto nhits = GET_FRAMEHEADER_NUMBEROFHITS(*mPointer);
+    if (mEnd - mPointer <= nhits) break;
+    mFrames.push_back(mPointer);
+    mNumberOfHits += nhits;
+    mPointer += 1 + nhits;
+  }
+
+  /** crate trailer and diagnostic words **/
+  if (mPointer >= mEnd || !IS_CRATE_TRAILER(*mPointer) || mEnd - mPointer <= GET_CRATETRAILER_NUMBEROFDIAGNOSTICS(*mPointer)) {
+    std::cout << colorRed
+	      << "-E- truncated crate at byte " << offset()
+	      << std::endl;
+    mError = true;
+    return true;
+  }
+  mCrateHeader = header;
+  mCrateTrailer = mPointer;
+  mPointer += 1 + GET_CRATETRAILER_NUMBEROFDIAGNOSTICS(*mPointer);
+  return false;
+}
+
+int
+TOFreader::unpack(Hits_t &hits) const
+{
+  if ((int)hits.Time.size() < mNumberOfHits) {
+    hits.Time.resize(mNumberOfHits);
+    hits.TOT.resize(mNumberOfHits);
+    hits.Channel.resize(mNumberOfHits);
+    hits.TDCID.resize(mNumberOfHits);
+    hits.Chain.resize(mNumberOfHits);
+    hits.TRMID.resize(mNumberOfHits);
+  }
+  hits.nHits = mNumberOfHits;
+
+  /** branch-free loops over the packed words of each frame, meant to vectorise **/
+  int ihit = 0;
+  for (auto frame : mFrames) {
+    uint32_t nhits = GET_FRAMEHEADER_NUMBEROFHITS(*frame);
+    uint32_t frameTime = GET_FRAMEHEADER_FRAMEID(*frame) << 13;
+    uint8_t trmid = GET_FRAMEHEADER_TRMID(*frame);
+    const uint32_t * __restrict__ packed = frame + 1;
+    uint32_t * __restrict__ time = hits.Time.data() + ihit;
+    uint16_t * __restrict__ tot = hits.TOT.data() + ihit;
+    uint8_t * __restrict__ channel = hits.Channel.data() + ihit;
+    uint8_t * __restrict__ tdcid = hits.TDCID.data() + ihit;
+    uint8_t * __restrict__ chain = hits.Chain.data() + ihit;
+    uint8_t * __restrict__ trm = hits.TRMID.data() + ihit;
+    for (uint32_t i = 0; i < nhits; ++i) {
+      uint32_t word = packed[i];
+      time[i]    = frameTime | GET_PACKEDHIT_TIME(word);
+      tot[i]     = GET_PACKEDHIT_TOT(word);
+      channel[i] = GET_PACKEDHIT_CHANNEL(word);
+      tdcid[i]   = GET_PACKEDHIT_TDCID(word);
+      chain[i]   = GET_PACKEDHIT_CHAIN(word);
+      trm[i]     = trmid;
+    }
+    ihit += nhits;
+  }
+  return ihit;
+}
+
+bool
+TOFreader::scan(Scan_t &scan, bool unpackHits)
+{
+  Hits_t hits;
+  while (!next()) {
+    scan.Crates++;
+    scan.Frames += mFrames.size();
+    scan.Hits += mNumberOfHits;
+    for (auto frame : mFrames)
+      scan.TRMHits[GET_FRAMEHEADER_TRMID(*frame)] += GET_FRAMEHEADER_NUMBEROFHITS(*frame);
+    auto ndiagnostics = getNumberOfDiagnostics();
+    auto diagnostics = getDiagnostics();
+    scan.Diagnostics += ndiagnostics;
+    for (int idiag = 0; idiag < ndiagnostics; ++idiag) {
+      auto word = diagnostics[idiag];
+      scan.SlotDiagnostics[GET_DIAGNOSTIC_SLOTID(word)]++;
+      for (int ibit = 0; ibit < 28; ++ibit)
+	if (GET_DIAGNOSTIC_FAULTBITS(word) & (1 << ibit)) scan.FaultBits[ibit]++;
+    }
+    if (unpackHits) {
+      auto nhits = unpack(hits);
+      for (int ihit = 0; ihit < nhits; ++ihit)
+	scan.SumTOT += hits.TOT[ihit];
+    }
+  }
+  scan.Bytes = offset();
+  return mError;
+}
+
+void
+TOFreader::scanSummary(const Scan_t &scan)
+{
+  std::cout << colorBlue
+	    << "--- SCAN SUMMARY: " << scan.Crates << " crates, " << scan.Bytes << " bytes"
+	    << "\033[0m" << std::endl;
+  if (scan.Crates == 0) return;
+  printf("\n");
+  printf("    frames: %10lu   (%6.2f / crate) \n", (unsigned long)scan.Frames, (double)scan.Frames / scan.Crates);
+  printf("      hits: %10lu   (%6.2f / crate) \n", (unsigned long)scan.Hits, (double)scan.Hits / scan.Crates);
+  if (scan.SumTOT > 0)
+    printf("  mean TOT: %10.2f \n", (double)scan.SumTOT / scan.Hits);
+  printf("     diags: %10lu   (%6.2f / crate) \n", (unsigned long)scan.Diagnostics, (double)scan.Diagnostics / scan.Crates);
+  printf("\n");
+  for (int islot = 0; islot < 16; ++islot) {
+    if (scan.TRMHits[islot] == 0 && scan.SlotDiagnostics[islot] == 0) continue;
+    printf(" %2d slot    hits: %10lu    diags: \033%s%10lu\033[0m \n", islot, (unsigned long)scan.TRMHits[islot],
+	   scan.SlotDiagnostics[islot] > 0 ? "[1;31m" : "[0m", (unsigned long)scan.SlotDiagnostics[islot]);
+  }
+  printf("\n");
+  for (int ibit = 0; ibit < 28; ++ibit) {
+    if (scan.FaultBits[ibit] == 0) continue;
+    printf("    fault bit 0x%08x: %10lu \n", 1 << (ibit + 4), (unsigned long)scan.FaultBits[ibit]);
+  }
+  printf("\n");
+}
+
+}}
@@ -0,0 +1,99 @@
+#ifndef _TOF_READER_H_
+#define _TOF_READER_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "dataFormat.h"
+
+namespace tof {
+namespace data {
+
+/**
+ ** reader for the compressed data format
+ ** iterates crates in a memory buffer or in a mapped file, giving
+ ** access to the frames, the packed hits and the diagnostic words
+ ** of the current crate without copying them
+ **/
+
+class TOFreader {
+
+public:
+
+  /** hits of a crate unpacked into arrays, one entry per hit **/
+  struct Hits_t {
+    int                   nHits = 0;
+    std::vector<uint32_t> Time;     // FrameID << 13 | Time, in TDC bins
+    std::vector<uint16_t> TOT;
+    std::vector<uint8_t>  Channel;
+    std::vector<uint8_t>  TDCID;
+    std::vector<uint8_t>  Chain;
+    std::vector<uint8_t>  TRMID;
+  };
+
+  /** crate-level statistics collected by scan **/
+  struct Scan_t {
+    uint64_t Crates              = 0;
+    uint64_t Bytes               = 0;
+    uint64_t Frames              = 0;
+    uint64_t Hits                = 0;
+    uint64_t SumTOT              = 0;
+    uint64_t Diagnostics         = 0;
+    uint64_t TRMHits[16]         = {};
+    uint64_t SlotDiagnostics[16] = {};
+    uint64_t FaultBits[28]       = {};
+  };
+
+  TOFreader() {};
+  ~TOFreader() { close(); };
+
+  bool open(std::string name);
+  bool close();
+  void setBuffer(const char *buffer, long size);
+  void rewind() { mPointer = mBegin; mError = false; };
+
+  /** move to the next crate, returns true at the end of data or on a format error **/
+  bool next();
+  bool error() const { return mError; };
+  /** byte offset of the current position **/
+  long offset() const { return (const char *)mPointer - (const char *)mBegin; };
+
+  /** current crate **/
+  uint32_t getCrateHeader() const { return *mCrateHeader; };
+  uint32_t getCrateOrbit() const { return *(mCrateHeader + 1); };
+  uint32_t getCrateTrailer() const { return *mCrateTrailer; };
+  int getNumberOfFrames() const { return mFrames.size(); };
+  uint32_t getFrameHeader(int iframe) const { return *mFrames[iframe]; };
+  const uint32_t *getFrameHits(int iframe) const { return mFrames[iframe] + 1; };
+  int getNumberOfHits() const { return mNumberOfHits; };
+  int getNumberOfDiagnostics() const { return GET_CRATETRAILER_NUMBEROFDIAGNOSTICS(*mCrateTrailer); };
+  const uint32_t *getDiagnostics() const { return mCrateTrailer + 1; };
+
+  /** unpack all hits of the current crate **/
+  int unpack(Hits_t &hits) const;
+
+  /** iterate all remaining crates collecting statistics, returns true on a format error **/
+  bool scan(Scan_t &scan, bool unpackHits = false);
+  static void scanSummary(const Scan_t &scan);
+
+private:
+
+  const uint32_t *mBegin        = nullptr;
+  const uint32_t *mEnd          = nullptr;
+  const uint32_t *mPointer      = nullptr;
+  bool            mError        = false;
+
+  const uint32_t *mCrateHeader  = nullptr;
+  const uint32_t *mCrateTrailer = nullptr;
+  std::vector<const uint32_t *> mFrames;
+  int             mNumberOfHits = 0;
+
+  int             mFD           = -1;
+  char           *mMap          = nullptr;
+  long            mMapSize      = 0;
+
+};
+
+}}
+
+#endif /** _TOF_READER_H_ **/
@@ -0,0 +1,285 @@
+#include "TOFring.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define colorRed     "\033[1;31m"
+#define colorYellow  "\033[1;33m"
+#define colorBlue    "\033[1;34m"
+
+namespace tof {
+namespace data {
+
+namespace {
+
+  const std::string sRingPrefix = "shm:";
+
+}
+
+bool
+TOFring::isRing(std::string name)
+{
+  return name.compare(0, sRingPrefix.size(), sRingPrefix) == 0;
+}
+
+std::string
+TOFring::ringName(std::string name)
+{
+  /** POSIX shared memory names start with a slash **/
+  name = name.substr(sRingPrefix.size());
+  return name[0] == '/' ? name : "/" + name;
+}
+
+uint64_t
+TOFring::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void
+TOFring::backoff(int &iteration)
+{
+  /** spin shortly, then leave the core to the other side **/
+  if (iteration < 64) __builtin_ia32_pause();
+  else if (iteration < 1024) std::this_thread::yield();
+  else std::this_thread::sleep_for(std::chrono::microseconds(20));
+  iteration++;
+}
+
+bool
+TOFring::create(std::string name, long size)
+{
+  static_assert(sizeof(Header_t) <= HeaderSize, "ring header too large");
+  close();
+  size = (size + Alignment - 1) & ~(Alignment - 1);
+  mName = ringName(name);
+  shm_unlink(mName.c_str());
+  int fd = shm_open(mName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd == -1 || ftruncate(fd, HeaderSize + size) == -1) {
+    std::cerr << colorRed
+	      << "-E- Cannot create shared memory ring: " << mName << ": " << std::strerror(errno)
+	      << std::endl;
+    if (fd != -1) {
+      ::close(fd);
+      shm_unlink(mName.c_str());
+    }
+    return true;
+  }
+  void *map = mmap(nullptr, HeaderSize + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    std::cerr << colorRed
+	      << "-E- Cannot map shared memory ring: " << mName
+	      << std::endl;
+    shm_unlink(mName.c_str());
+    return true;
+  }
+  mMap = (char *)map;
+  mMapSize = HeaderSize + size;
+  mRing = new (mMap) Header_t;
+  mRing->Size = size;
+  mRing->Head.store(0);
+  mRing->Tail.store(0);
+  mRing->Done.store(0);
+  mRing->Attached.store(kWaiting);
+  /** the magic is published last, the consumer checks it when attaching **/
+  std::atomic_thread_fence(std::memory_order_release);
+  mRing->Magic = Magic;
+  mData = mMap + HeaderSize;
+  mRingSize = size;
+  mOwner = true;
+  return false;
+}
+
+bool
+TOFring::attach(std::string name)
+{
+  close();
+  mName = ringName(name);
+  int fd = shm_open(mName.c_str(), O_RDWR, 0);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) == -1 || st.st_size < HeaderSize) {
+    std::cerr << colorRed
+	      << "-E- Cannot open shared memory ring: " << mName << ": " << std::strerror(errno)
+	      << std::endl;
+    if (fd != -1) ::close(fd);
+    return true;
+  }
+  void *map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    std::cerr << colorRed
+	      << "-E- Cannot map shared memory ring: " << mName
+	      << std::endl;
+    return true;
+  }
+  mMap = (char *)map;
+  mMapSize = st.st_size;
+  mRing = reinterpret_cast<Header_t *>(mMap);
+  if (mRing->Magic != Magic || (long)mRing->Size + HeaderSize > mMapSize) {
+    std::cerr << colorRed
+	      << "-E- not a page ring: " << mName
+	      << std::endl;
+    close();
+    return true;
+  }
+  mData = mMap + HeaderSize;
+  mOwner = false;
+  mRingSize = mRing->Size;
+  mPosition = mRing->Tail.load(std::memory_order_acquire);
+  mPending.clear();
+  mRing->Attached.store(kAttached, std::memory_order_release);
+  return false;
+}
+
+bool
+TOFring::close()
+{
+  if (!mRing) return true;
+  /** a producer still pushing or finishing does not wait for a consumer that left **/
+  if (!mOwner && mRing->Attached.load() == kAttached)
+    mRing->Attached.store(kDetached, std::memory_order_release);
+  munmap(mMap, mMapSize);
+  if (mOwner) shm_unlink(mName.c_str());
+  mMap = nullptr;
+  mMapSize = 0;
+  mRing = nullptr;
+  mData = nullptr;
+  mOwner = false;
+  return false;
+}
+
+bool
+TOFring::push(const char *page, long size)
+{
+  uint64_t ringSize = mRing->Size;
+  uint64_t length = (sizeof(Record_t) + size + Alignment - 1) & ~(Alignment - 1);
+  if (length > ringSize) {
+    std::cerr << colorRed
+	      << "-E- page larger than the ring: " << size << " bytes"
+	      << std::endl;
+    return true;
+  }
+  uint64_t head = mRing->Head.load(std::memory_order_relaxed);
+  uint64_t offset = head % ringSize;
+  /** a page is never split at the end of the ring **/
+  uint64_t padding = ringSize - offset < length ? ringSize - offset : 0;
+
+  /** wait for room **/
+  int iteration = 0;
+  while (head + padding + length - mRing->Tail.load(std::memory_order_acquire) > ringSize) {
+    if (mRing->Attached.load(std::memory_order_acquire) == kDetached) {
+      std::cerr << colorRed
+		<< "-E- the consumer left the ring"
+		<< std::endl;
+      return true;
+    }
+    backoff(iteration);
+  }
+
+  if (padding) {
+    auto record = reinterpret_cast<Record_t *>(mData + offset);
+    record->Size = 0;
+    record->Length = padding;
+    record->Stamp = 0;
+    head += padding;
+    offset = 0;
+  }
+  auto record = reinterpret_cast<Record_t *>(mData + offset);
+  std::memcpy(mData + offset + sizeof(Record_t), page, size);
+  record->Size = size;
+  record->Length = length;
+  record->Stamp = now();
+  mRing->Head.store(head + length, std::memory_order_release);
+  return false;
+}
+
+void
+TOFring::finish()
+{
+  mRing->Done.store(1, std::memory_order_release);
+  int iteration = 0;
+  while (true) {
+    auto attached = mRing->Attached.load(std::memory_order_acquire);
+    if (attached == kDetached) return;
+    if (attached == kAttached && mRing->Tail.load(std::memory_order_acquire) == mRing->Head.load(std::memory_order_relaxed)) return;
+    backoff(iteration);
+  }
+}
+
+bool
+TOFring::available() const
+{
+  return mRing->Head.load(std::memory_order_acquire) != mPosition;
+}
+
+const char *
+TOFring::next(long &size)
+{
+  uint64_t ringSize = mRing->Size;
+  int iteration = 0;
+  while (true) {
+    uint64_t head = mRing->Head.load(std::memory_order_acquire);
+    if (head == mPosition) {
+      /** the head is read again after the flag, a last page is not lost **/
+      if (mRing->Done.load(std::memory_order_acquire) && mRing->Head.load(std::memory_order_acquire) == mPosition)
+	return nullptr;
+      if (iteration == 0) mWaits++;
+      backoff(iteration);
+      continue;
+    }
+    auto record = reinterpret_cast<const Record_t *>(mData + mPosition % ringSize);
+    if (record->Size == 0) {
+      /** padding, the page is at the start of the ring **/
+      mPosition += record->Length;
+      continue;
+    }
+    uint64_t backlog = head - mPosition;
+    mBacklogSum += backlog;
+    if (backlog > mBacklogMax) mBacklogMax = backlog;
+    mPending.push_back(record->Stamp);
+    mPosition += record->Length;
+    mPages++;
+    mBytes += record->Size;
+    size = record->Size;
+    return reinterpret_cast<const char *>(record) + sizeof(Record_t);
+  }
+}
+
+void
+TOFring::release()
+{
+  if (!mRing) return;
+  if (!mPending.empty()) {
+    uint64_t stamp = now();
+    for (auto pushed : mPending) {
+      uint64_t latency = stamp - pushed;
+      mLatencySum += latency;
+      if (latency > mLatencyMax) mLatencyMax = latency;
+    }
+    mPending.clear();
+  }
+  mRing->Tail.store(mPosition, std::memory_order_release);
+}
+
+void
+TOFring::summary() const
+{
+  std::cout << colorBlue
+	    << "--- RING SUMMARY: " << mPages << " pages, " << mBytes << " bytes"
+	    << "\033[0m" << std::endl;
+  if (mPages == 0) return;
+  printf("    latency (push to release): mean %.1f us, max %.1f us \n", mLatencySum / mPages * 1.e-3, mLatencyMax * 1.e-3);
+  printf("    backlog: mean %.0f bytes, max %lu bytes, ring %lu bytes \n", mBacklogSum / mPages, (unsigned long)mBacklogMax, (unsigned long)mRingSize);
+  printf("    consumer waits for data: %ld \n", mWaits);
+}
+
+}}
@@ -0,0 +1,108 @@
+#ifndef _TOF_RING_H_
+#define _TOF_RING_H_
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+namespace tof {
+namespace data {
+
+/**
+ ** single-producer/single-consumer ring of RDH pages in POSIX shared
+ ** memory, synchronised with atomics only
+ ** the producer copies each page contiguously into the ring, a page that
+ ** does not fit before the end of the ring is preceded by a padding
+ ** record; the consumer reads the pages in place and releases them once
+ ** decoded, the producer waits for room while the ring is full
+ **/
+
+class TOFring {
+
+public:
+
+  TOFring() {};
+  ~TOFring() { close(); };
+
+  /** producer: create the ring with this many bytes of pages **/
+  bool create(std::string name, long size);
+  /** consumer: attach to the ring created by the producer **/
+  bool attach(std::string name);
+  bool close();
+  bool isOpen() const { return mRing != nullptr; };
+
+  /** producer: copy a page into the ring, waits for room **/
+  bool push(const char *page, long size);
+  /** producer: no more pages, waits until the consumer released all of them or left **/
+  void finish();
+
+  /** consumer: wait for the next page, nullptr at the end of data **/
+  const char *next(long &size);
+  /** consumer: there is a page without waiting **/
+  bool available() const;
+  /** consumer: give all pages returned by next() back to the producer **/
+  void release();
+  void summary() const;
+
+  /** names in the shm:<name> form are rings **/
+  static bool isRing(std::string name);
+  static std::string ringName(std::string name);
+
+private:
+
+  struct Header_t {
+    uint64_t                          Magic;
+    uint64_t                          Size;
+    alignas(64) std::atomic<uint64_t> Head;     // bytes written by the producer
+    alignas(64) std::atomic<uint64_t> Tail;     // bytes released by the consumer
+    alignas(64) std::atomic<uint32_t> Done;
+    std::atomic<uint32_t>             Attached;
+  };
+
+  /** in front of each page, 64-byte aligned **/
+  struct Record_t {
+    uint32_t Size;      // page bytes, 0 for padding up to the end of the ring
+    uint32_t Length;    // record bytes including this header
+    uint64_t Stamp;     // steady clock of the push, ns
+  };
+
+  enum EAttached_t {
+    kWaiting,   // no consumer yet
+    kAttached,
+    kDetached   // the consumer closed the ring
+  };
+
+  static const uint64_t Magic = 0x544f4652494e4731; // TOFRING1
+  static const long     HeaderSize = 256;
+  static const long     Alignment = 64;
+
+  static uint64_t now();
+  static void backoff(int &iteration);
+
+  std::string mName;
+  bool        mOwner   = false;
+  char       *mMap     = nullptr;
+  long        mMapSize = 0;
+  Header_t   *mRing    = nullptr;
+  char       *mData    = nullptr;
+  uint64_t    mRingSize = 0;
+
+  /** consumer position, pages before it were handed out and not released yet **/
+  uint64_t              mPosition = 0;
+  std::vector<uint64_t> mPending;
+
+  /** consumer statistics **/
+  long     mPages           = 0;
+  long     mBytes           = 0;
+  double   mLatencySum      = 0.;
+  uint64_t mLatencyMax      = 0;
+  double   mBacklogSum      = 0.;
+  uint64_t mBacklogMax      = 0;
+  long     mWaits           = 0;
+
+};
+
+}}
+
+#endif /** _TOF_RING_H_ **/
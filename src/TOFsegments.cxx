@@ -0,0 +1,116 @@
+#include "TOFsegments.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
+#include <unistd.h>
+
+#define colorRed     "\033[1;31m"
+
+namespace tof {
+namespace data {
+
+TOFsegments::TOFsegments(char *memory, long capacity) :
+  mSegmentSize(capacity),
+  mExternal(true)
+{
+  Segment segment = {memory, capacity, 0};
+  mSegments.push_back(segment);
+}
+
+TOFsegments::~TOFsegments()
+{
+  if (mExternal) return;
+  for (auto &segment : mSegments)
+    delete [] segment.Memory;
+}
+
+TOFsegments::TOFsegments(TOFsegments &&other) :
+  mSegments(std::move(other.mSegments)),
+  mCurrent(other.mCurrent),
+  mSegmentSize(other.mSegmentSize),
+  mSize(other.mSize),
+  mExternal(other.mExternal)
+{
+  other.mSegments.clear();
+  other.mCurrent = 0;
+  other.mSize = 0;
+}
+
+char *
+TOFsegments::reserve(long size)
+{
+  if (mSegments.empty() || mSegments[mCurrent].Capacity - mSegments[mCurrent].Fill < size) {
+    if (mExternal) return nullptr;
+    if (!mSegments.empty() && mSegments[mCurrent].Fill > 0) mCurrent++;
+    if (mCurrent == (int)mSegments.size()) {
+      Segment segment = {nullptr, 0, 0};
+      mSegments.push_back(segment);
+    }
+    auto &segment = mSegments[mCurrent];
+    if (segment.Capacity < size) {
+      delete [] segment.Memory;
+      segment.Capacity = std::max(size, mSegmentSize);
+      segment.Memory = new char[segment.Capacity];
+    }
+    segment.Fill = 0;
+  }
+  auto &segment = mSegments[mCurrent];
+  return segment.Memory + segment.Fill;
+}
+
+void
+TOFsegments::gather(std::vector<struct iovec> &iov, long begin, long end) const
+{
+  if (end < 0 || end > mSize) end = mSize;
+  long offset = 0;
+  for (int iseg = 0; iseg <= mCurrent && iseg < (int)mSegments.size() && offset < end; ++iseg) {
+    auto &segment = mSegments[iseg];
+    long first = std::max(begin, offset);
+    long last  = std::min(end, offset + segment.Fill);
+    if (first < last) {
+      struct iovec vec = {segment.Memory + (first - offset), (size_t)(last - first)};
+      iov.push_back(vec);
+    }
+    offset += segment.Fill;
+  }
+}
+
+void
+TOFsegments::clear()
+{
+  for (auto &segment : mSegments) segment.Fill = 0;
+  mCurrent = 0;
+  mSize = 0;
+}
+
+bool
+TOFsegments::write(int fd, const std::vector<struct iovec> &iov)
+{
+  std::vector<struct iovec> pending(iov);
+  size_t first = 0;
+  while (first < pending.size()) {
+    int count = std::min(pending.size() - first, (size_t)IOV_MAX);
+    long written = writev(fd, &pending[first], count);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << colorRed
+		<< "-E- output write failed: " << std::strerror(errno)
+		<< std::endl;
+      return true;
+    }
+    /** skip what was written, a partial iovec is resumed **/
+    while (first < pending.size() && written >= (long)pending[first].iov_len) {
+      written -= pending[first].iov_len;
+      first++;
+    }
+    if (written > 0) {
+      pending[first].iov_base = (char *)pending[first].iov_base + written;
+      pending[first].iov_len -= written;
+    }
+  }
+  return false;
+}
+
+}}
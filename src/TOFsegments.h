@@ -0,0 +1,64 @@
+#ifndef _TOF_SEGMENTS_H_
+#define _TOF_SEGMENTS_H_
+
+#include <vector>
+#include <sys/uio.h>
+
+namespace tof {
+namespace data {
+
+/**
+ ** chain of large output segments
+ ** the encoder reserves room for a whole event in the current segment,
+ ** writes in place and commits what it used; the committed data are
+ ** seen as one contiguous byte range and can be gathered into iovecs
+ **/
+
+class TOFsegments {
+
+public:
+
+  TOFsegments(long segmentSize = 1048576) : mSegmentSize(segmentSize) {};
+  /** a single segment over memory owned by the caller, reserve() fails when it is full **/
+  TOFsegments(char *memory, long capacity);
+  ~TOFsegments();
+  TOFsegments(TOFsegments &&other);
+  TOFsegments(const TOFsegments &other) = delete;
+  TOFsegments &operator=(const TOFsegments &other) = delete;
+
+  void setSegmentSize(long val) { mSegmentSize = val; };
+
+  /** pointer to at least size free bytes, moves to a new segment if needed, nullptr if the caller memory is full **/
+  char *reserve(long size);
+  /** commit size bytes written at the last reserved pointer **/
+  inline void commit(long size) { mSegments[mCurrent].Fill += size; mSize += size; };
+  /** committed bytes **/
+  long size() const { return mSize; };
+  bool empty() const { return mSize == 0; };
+  /** append iovecs covering committed bytes [begin, end), end < 0 means all **/
+  void gather(std::vector<struct iovec> &iov, long begin = 0, long end = -1) const;
+  /** drop the data, the segments are kept for reuse **/
+  void clear();
+
+  /** write iovecs to a file descriptor with as few writev calls as possible **/
+  static bool write(int fd, const std::vector<struct iovec> &iov);
+
+private:
+
+  struct Segment {
+    char *Memory;
+    long  Capacity;
+    long  Fill;
+  };
+
+  std::vector<Segment> mSegments;
+  int                  mCurrent     = 0;
+  long                 mSegmentSize;
+  long                 mSize        = 0;
+  bool                 mExternal    = false;
+
+};
+
+}}
+
+#endif /** _TOF_SEGMENTS_H_ **/
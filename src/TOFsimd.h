@@ -0,0 +1,147 @@
+#ifndef _TOF_SIMD_H_
+#define _TOF_SIMD_H_
+
+#include <cstdint>
+#include <cstring>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace tof {
+namespace data {
+
+/**
+ ** vector kernels of the decoder
+ ** the instruction set is chosen at compile time (-mavx2, -mavx512f or
+ ** ENABLE_NATIVE), the scalar versions give identical results
+ **/
+
+namespace simd {
+
+#if defined(__AVX512F__)
+constexpr const char *kKernels = "avx512";
+#elif defined(__AVX2__)
+constexpr const char *kKernels = "avx2";
+#else
+constexpr const char *kKernels = "scalar";
+#endif
+
+}
+
+/**
+ ** GBT de-padding: raw words are GBT padded, two payload words every
+ ** 128 bits; the payload of size bytes of GBT words is compacted into a
+ ** dense stream, returns the number of payload words
+ **/
+inline long
+depad(const uint32_t *gbt, long size, uint32_t *dense)
+{
+  long ngbt = size / 16;
+  long igbt = 0;
+
+#if defined(__AVX512F__)
+  /** eight GBT words per block, payload lanes of two loads in one store **/
+  const __m512i payload = _mm512_setr_epi32(0, 1, 4, 5, 8, 9, 12, 13, 16, 17, 20, 21, 24, 25, 28, 29);
+  for (; igbt + 8 <= ngbt; igbt += 8) {
+    __m512i lo = _mm512_loadu_si512(gbt + 4 * igbt);
+    __m512i hi = _mm512_loadu_si512(gbt + 4 * igbt + 16);
+    _mm512_storeu_si512(dense + 2 * igbt, _mm512_permutex2var_epi32(lo, payload, hi));
+  }
+#elif defined(__AVX2__)
+  /** four GBT words per block, the payload is the even 64-bit lanes **/
+  for (; igbt + 4 <= ngbt; igbt += 4) {
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(gbt + 4 * igbt));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(gbt + 4 * igbt + 8));
+    __m256i even = _mm256_unpacklo_epi64(lo, hi);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dense + 2 * igbt), _mm256_permute4x64_epi64(even, 0xd8));
+  }
+#endif
+
+  /** scalar, or the tail of the page **/
+  for (; igbt < ngbt; ++igbt)
+    std::memcpy(dense + 2 * igbt, gbt + 4 * igbt, 8);
+
+  /** a truncated GBT word carries at most two payload words **/
+  long ntail = (size % 16) / 4;
+  if (ntail > 2) ntail = 2;
+  std::memcpy(dense + 2 * ngbt, gbt + 4 * ngbt, 4 * ntail);
+  return 2 * ngbt + ntail;
+}
+
+/**
+ ** bulk classification of raw words inside a TRM chain
+ ** TDC hits are the only words with bit 31 set, hence a block of dense
+ ** words is classified at once from the sign bits (hit or not) and the
+ ** length of the run of consecutive hits is found from the first
+ ** non-hit word; words at or beyond end are not read
+ **/
+inline int
+hitRun(const uint32_t *pointer, const uint32_t *end)
+{
+  int nhits = 0;
+
+#if defined(__AVX512F__)
+  const __m512i zero = _mm512_setzero_si512();
+  for (; pointer + 16 <= end; pointer += 16, nhits += 16) {
+    uint32_t other = ~_mm512_cmplt_epi32_mask(_mm512_loadu_si512(pointer), zero) & 0xffff;
+    if (other) return nhits + __builtin_ctz(other);
+  }
+#elif defined(__AVX2__)
+  for (; pointer + 8 <= end; pointer += 8, nhits += 8) {
+    uint32_t other = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(pointer)))) & 0xff;
+    if (other) return nhits + __builtin_ctz(other);
+  }
+#endif
+
+  /** scalar, or the tail of the page **/
+  for (; pointer < end && (*pointer & 0x80000000); ++pointer)
+    ++nhits;
+  return nhits;
+}
+
+/**
+ ** resynchronisation search after corrupted data
+ ** returns the first word that looks like a DRM common header (top
+ ** nibble 4) followed two words later by a DRM global header (top
+ ** nibble 4, slot 1), or end if there is none; a block of candidate
+ ** positions is tested at once with two shifted loads, words at or
+ ** beyond end are not read
+ **/
+inline const uint32_t *
+headerPair(const uint32_t *pointer, const uint32_t *end)
+{
+#if defined(__AVX512F__)
+  const __m512i commonMask = _mm512_set1_epi32(0xF0000000);
+  const __m512i common     = _mm512_set1_epi32(0x40000000);
+  const __m512i globalMask = _mm512_set1_epi32(0xF000000F);
+  const __m512i global     = _mm512_set1_epi32(0x40000001);
+  for (; pointer + 18 <= end; pointer += 16) {
+    __mmask16 match = _mm512_cmpeq_epi32_mask(_mm512_and_si512(_mm512_loadu_si512(pointer), commonMask), common)
+      & _mm512_cmpeq_epi32_mask(_mm512_and_si512(_mm512_loadu_si512(pointer + 2), globalMask), global);
+    if (match) return pointer + __builtin_ctz(match);
+  }
+#elif defined(__AVX2__)
+  const __m256i commonMask = _mm256_set1_epi32(0xF0000000);
+  const __m256i common     = _mm256_set1_epi32(0x40000000);
+  const __m256i globalMask = _mm256_set1_epi32(0xF000000F);
+  const __m256i global     = _mm256_set1_epi32(0x40000001);
+  for (; pointer + 10 <= end; pointer += 8) {
+    __m256i first  = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pointer));
+    __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pointer + 2));
+    __m256i match  = _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_and_si256(first, commonMask), common),
+				      _mm256_cmpeq_epi32(_mm256_and_si256(second, globalMask), global));
+    uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(match));
+    if (mask) return pointer + __builtin_ctz(mask);
+  }
+#endif
+
+  /** scalar, or the tail of the page **/
+  for (; pointer + 2 < end; ++pointer)
+    if ((pointer[0] & 0xF0000000) == 0x40000000 && (pointer[2] & 0xF000000F) == 0x40000001)
+      return pointer;
+  return end;
+}
+
+}}
+
+#endif /** _TOF_SIMD_H_ **/
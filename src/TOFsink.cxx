@@ -0,0 +1,87 @@
+#include "TOFsink.h"
+#include "TOFstream.h"
+#include <iostream>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define colorRed     "\033[1;31m"
+
+namespace tof {
+namespace data {
+
+bool
+TOFmemorySink::write(const std::vector<struct iovec> &iov)
+{
+  long size = 0;
+  for (auto &vec : iov) size += vec.iov_len;
+  char *memory = mSegments.reserve(size);
+  if (!memory) {
+    std::cerr << colorRed
+	      << "-E- memory sink full: " << mSegments.size() << " bytes"
+	      << std::endl;
+    return true;
+  }
+  for (auto &vec : iov) {
+    std::memcpy(memory, vec.iov_base, vec.iov_len);
+    memory += vec.iov_len;
+  }
+  mSegments.commit(size);
+  return false;
+}
+
+bool
+TOFcallbackSink::write(const std::vector<struct iovec> &iov)
+{
+  for (auto &vec : iov)
+    if (mCallback((const char *)vec.iov_base, vec.iov_len)) return true;
+  return false;
+}
+
+bool
+TOFfileSink::open(std::string name)
+{
+  close();
+  if (TOFstream::isStream(name)) {
+    TOFstream output;
+    if (output.openOutput(name)) return true;
+    mFD = output.dup();
+    return mFD == -1;
+  }
+  mFD = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (mFD == -1) {
+    std::cerr << colorRed << "-E- Cannot open output file: " << name
+	      << std::endl;
+    return true;
+  }
+  return false;
+}
+
+bool
+TOFfileSink::close()
+{
+  if (mFD == -1) return false;
+  bool status = ::close(mFD) != 0;
+  mFD = -1;
+  return status;
+}
+
+bool
+TOFfileSink::write(const std::vector<struct iovec> &iov)
+{
+  if (mFD == -1) {
+    std::cerr << colorRed << "-E- no output file is open"
+	      << std::endl;
+    return true;
+  }
+  return TOFsegments::write(mFD, iov);
+}
+
+bool
+TOFnullSink::write(const std::vector<struct iovec> &iov)
+{
+  for (auto &vec : iov) mSize += vec.iov_len;
+  return false;
+}
+
+}}
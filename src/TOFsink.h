@@ -0,0 +1,106 @@
+#ifndef _TOF_SINK_H_
+#define _TOF_SINK_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <sys/uio.h>
+#include "TOFsegments.h"
+
+namespace tof {
+namespace data {
+
+/**
+ ** destination of the compressed data
+ ** a sink either lends its own memory to the encoder, which then writes
+ ** the events in place, or takes the encoded bytes from the encoder
+ ** segments with write(); the iovecs point into the encoder memory and
+ ** are only valid during the call
+ **/
+
+class TOFsink {
+
+public:
+
+  virtual ~TOFsink() {};
+
+  /** memory the encoder writes the events into, nullptr if the sink takes them with write() **/
+  virtual TOFsegments *segments() { return nullptr; };
+  virtual bool write(const std::vector<struct iovec> &iov) = 0;
+
+};
+
+/** caller-owned buffer, events are encoded in place **/
+class TOFmemorySink : public TOFsink {
+
+public:
+
+  TOFmemorySink(char *memory, long capacity) : mSegments(memory, capacity) {};
+
+  virtual TOFsegments *segments() { return &mSegments; };
+  /** copies, for the output of the read()/write() interface **/
+  virtual bool write(const std::vector<struct iovec> &iov);
+
+  long size() const { return mSegments.size(); };
+  void clear() { mSegments.clear(); };
+
+private:
+
+  TOFsegments mSegments;
+
+};
+
+/** calls back with each contiguous range of encoded bytes, true stops the decoding **/
+class TOFcallbackSink : public TOFsink {
+
+public:
+
+  typedef std::function<bool(const char *data, long size)> Callback_t;
+
+  TOFcallbackSink(Callback_t callback) : mCallback(callback) {};
+
+  virtual bool write(const std::vector<struct iovec> &iov);
+
+private:
+
+  Callback_t mCallback;
+
+};
+
+/** file, named pipe, unix:<path> socket or - for the standard output, written with writev **/
+class TOFfileSink : public TOFsink {
+
+public:
+
+  TOFfileSink() {};
+  ~TOFfileSink() { close(); };
+
+  bool open(std::string name);
+  bool close();
+
+  virtual bool write(const std::vector<struct iovec> &iov);
+
+private:
+
+  int mFD = -1;
+
+};
+
+/** counts and drops the encoded bytes **/
+class TOFnullSink : public TOFsink {
+
+public:
+
+  virtual bool write(const std::vector<struct iovec> &iov);
+
+  long size() const { return mSize; };
+
+private:
+
+  long mSize = 0;
+
+};
+
+}}
+
+#endif /** _TOF_SINK_H_ **/
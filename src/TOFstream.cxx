@@ -0,0 +1,213 @@
+#include "TOFstream.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define colorRed     "\033[1;31m"
+#define colorYellow  "\033[1;33m"
+#define colorBlue    "\033[1;34m"
+
+namespace tof {
+namespace data {
+
+namespace {
+
+  const std::string sSocketPrefix = "unix:";
+
+  /** fill a socket address, returns true if the path does not fit **/
+  bool
+  socketAddress(const std::string &path, struct sockaddr_un &address)
+  {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+      std::cerr << colorRed
+		<< "-E- socket path too long: " << path
+		<< std::endl;
+      return true;
+    }
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    return false;
+  }
+
+}
+
+bool
+TOFstream::isStream(std::string name)
+{
+  if (name == "-" || name.compare(0, sSocketPrefix.size(), sSocketPrefix) == 0)
+    return true;
+  struct stat st;
+  if (stat(name.c_str(), &st) == -1) return false;
+  return S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode) || S_ISCHR(st.st_mode);
+}
+
+int
+TOFstream::dataStdout()
+{
+  static int fd = -1;
+  if (fd == -1) {
+    std::cout.flush();
+    fflush(stdout);
+    fd = ::dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+  }
+  return fd;
+}
+
+bool
+TOFstream::open(std::string name)
+{
+  close();
+
+  /** standard input **/
+  if (name == "-") {
+    mFD = STDIN_FILENO;
+    mOwned = false;
+    return false;
+  }
+
+  /** connect to the socket of the producer **/
+  if (name.compare(0, sSocketPrefix.size(), sSocketPrefix) == 0) {
+    std::string path = name.substr(sSocketPrefix.size());
+    struct sockaddr_un address;
+    if (socketAddress(path, address)) return true;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 || connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1) {
+      std::cerr << colorRed
+		<< "-E- Cannot connect to socket: " << path << ": " << std::strerror(errno)
+		<< std::endl;
+      if (fd != -1) ::close(fd);
+      return true;
+    }
+    mFD = fd;
+    mOwned = true;
+    return false;
+  }
+
+  /** file or named pipe, a pipe blocks here until a writer opens it **/
+  mFD = ::open(name.c_str(), O_RDONLY);
+  if (mFD == -1) {
+    std::cerr << colorRed
+	      << "-E- Cannot open input file: " << name
+	      << std::endl;
+    return true;
+  }
+  mOwned = true;
+  return false;
+}
+
+bool
+TOFstream::openOutput(std::string name)
+{
+  close();
+
+  /** standard output **/
+  if (name == "-") {
+    mFD = dataStdout();
+    mOwned = false;
+    return false;
+  }
+
+  /** listen on the socket and wait for one consumer **/
+  if (name.compare(0, sSocketPrefix.size(), sSocketPrefix) == 0) {
+    std::string path = name.substr(sSocketPrefix.size());
+    struct sockaddr_un address;
+    if (socketAddress(path, address)) return true;
+    unlink(path.c_str());
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server == -1 || bind(server, (struct sockaddr *)&address, sizeof(address)) == -1 || listen(server, 1) == -1) {
+      std::cerr << colorRed
+		<< "-E- Cannot listen on socket: " << path << ": " << std::strerror(errno)
+		<< std::endl;
+      if (server != -1) ::close(server);
+      return true;
+    }
+    std::cout << colorBlue
+	      << "--- WAITING FOR A CONSUMER ON SOCKET: " << path
+	      << "\033[0m" << std::endl;
+    int fd;
+    do {
+      fd = accept(server, nullptr, nullptr);
+    } while (fd == -1 && errno == EINTR);
+    ::close(server);
+    unlink(path.c_str());
+    if (fd == -1) {
+      std::cerr << colorRed
+		<< "-E- Cannot accept on socket: " << path << ": " << std::strerror(errno)
+		<< std::endl;
+      return true;
+    }
+    mFD = fd;
+    mOwned = true;
+    return false;
+  }
+
+  /** file or named pipe, a pipe blocks here until a reader opens it **/
+  mFD = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (mFD == -1) {
+    std::cerr << colorRed
+	      << "-E- Cannot open output file: " << name
+	      << std::endl;
+    return true;
+  }
+  mOwned = true;
+  return false;
+}
+
+bool
+TOFstream::close()
+{
+  if (mFD == -1) return true;
+  if (mOwned) ::close(mFD);
+  mFD = -1;
+  mOwned = false;
+  return false;
+}
+
+int
+TOFstream::dup() const
+{
+  if (mFD == -1) return -1;
+  return ::dup(mFD);
+}
+
+long
+TOFstream::read(char *buffer, long size)
+{
+  while (true) {
+    long nread = ::read(mFD, buffer, size);
+    if (nread >= 0) return nread;
+    if (errno == EINTR) continue;
+    std::cerr << colorRed
+	      << "-E- input read failed: " << std::strerror(errno)
+	      << std::endl;
+    return -1;
+  }
+}
+
+bool
+TOFstream::write(const char *buffer, long size)
+{
+  while (size > 0) {
+    long written = ::write(mFD, buffer, size);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << colorRed
+		<< "-E- output write failed: " << std::strerror(errno)
+		<< std::endl;
+      return true;
+    }
+    buffer += written;
+    size -= written;
+  }
+  return false;
+}
+
+}}
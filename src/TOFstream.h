@@ -0,0 +1,56 @@
+#ifndef _TOF_STREAM_H_
+#define _TOF_STREAM_H_
+
+#include <string>
+
+namespace tof {
+namespace data {
+
+/**
+ ** byte stream over a file descriptor, for data that cannot be seeked
+ ** or mapped: the standard input and output, named pipes and Unix domain
+ ** sockets; reads return what is available, the caller stitches pages
+ ** split across reads, writes are completed over partial writes
+ **
+ ** names: "-" is the standard input (output), "unix:<path>" a Unix
+ ** domain socket, anything else a file or a named pipe; an input socket
+ ** is connected to, an output socket is listened on for one client
+ **/
+
+class TOFstream {
+
+public:
+
+  TOFstream() {};
+  ~TOFstream() { close(); };
+
+  bool open(std::string name);
+  bool openOutput(std::string name);
+  bool close();
+  bool isOpen() const { return mFD != -1; };
+
+  /** read at most size bytes, returns the bytes read, 0 at the end of the stream, -1 on error **/
+  long read(char *buffer, long size);
+  /** write all size bytes **/
+  bool write(const char *buffer, long size);
+  /** a new descriptor of the stream, owned by the caller **/
+  int dup() const;
+
+  /** the name is a stream: standard input or output, socket or named pipe **/
+  static bool isStream(std::string name);
+  /**
+   ** descriptor of the standard output for data, from the first call on
+   ** console messages on the standard output go to the standard error
+   **/
+  static int dataStdout();
+
+private:
+
+  int  mFD    = -1;
+  bool mOwned = false;
+
+};
+
+}}
+
+#endif /** _TOF_STREAM_H_ **/
@@ -0,0 +1,135 @@
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include "TOFgenerator.h"
+#include "TOFbenchmark.h"
+#include "TOFsimd.h"
+
+int main(int argc, char **argv)
+{
+
+  std::string jsonFileName;
+  long nEvents = 2000;
+  uint64_t seed = 1;
+  std::vector<double> occupancies = {0.1, 1., 4.};
+  double trailingFraction = 1., faultRate = 0., minTime = 0.5;
+  int eventsPerPage = 0;
+  long pageSize = 8192;
+
+  /** define arguments **/
+  namespace po = boost::program_options;
+  po::options_description desc("Options");
+
+  try {
+
+    desc.add_options()
+      ("help", "Print help messages")
+      ("events,n", po::value<long>(&nEvents), "Number of events per occupancy level")
+      ("seed,s", po::value<uint64_t>(&seed), "Random seed")
+      ("hits-per-tdc", po::value<std::vector<double>>(&occupancies)->multitoken(), "Occupancy levels, mean leading hits per TDC and chain")
+      ("trailing-fraction", po::value<double>(&trailingFraction), "Fraction of leading hits followed by a trailing hit")
+      ("fault-rate", po::value<double>(&faultRate), "Injection rate of all faults")
+      ("events-per-page", po::value<int>(&eventsPerPage), "Maximum number of events per page, 0 fills pages")
+      ("page-size", po::value<long>(&pageSize), "Page size in bytes")
+      ("min-time", po::value<double>(&minTime), "Minimum time in seconds spent on each stage")
+      ("json", po::value<std::string>(&jsonFileName), "Write the results to this JSON file")
+      ;
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+
+    /** process arguments **/
+
+    /** help **/
+    if (vm.count("help")) {
+      std::cout << desc << std::endl;
+      return 1;
+    }
+    po::notify(vm);
+
+  }
+  catch(std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    std::cout << desc << std::endl;
+    return 1;
+  }
+
+  std::ofstream json;
+  if (!jsonFileName.empty()) {
+    json.open(jsonFileName.c_str());
+    if (!json.is_open()) {
+      std::cerr << "\033[1;31m-E- Cannot open output file: " << jsonFileName << std::endl;
+      return 1;
+    }
+    json << "{\n  \"compiler\": \"" << __VERSION__ << "\",\n"
+	 << "  \"kernels\": \"" << tof::data::simd::kKernels << "\",\n"
+	 << "  \"events\": " << nEvents << ",\n"
+	 << "  \"seed\": " << seed << ",\n"
+	 << "  \"results\": [";
+  }
+
+  tof::data::TOFbenchmark benchmark;
+  bool first = true;
+  for (auto occupancy : occupancies) {
+
+    /** in-memory payload **/
+    std::vector<char> raw;
+    tof::data::TOFgenerator generator;
+    generator.setSeed(seed);
+    generator.setHitsPerTDC(occupancy);
+    generator.setTrailingFraction(trailingFraction);
+    generator.setEventsPerPage(eventsPerPage);
+    generator.setPageSize(pageSize);
+    for (int ifault = 0; ifault < tof::data::TOFgenerator::kNFaults; ++ifault)
+      generator.setFaultRate(ifault, faultRate);
+    if (generator.generate(nEvents, raw)) return 1;
+
+    if (benchmark.prepare(raw)) return 1;
+    std::vector<tof::data::TOFbenchmark::Result_t> results;
+    if (benchmark.run(results, minTime)) return 1;
+
+    std::cout << "\033[1;34m"
+	      << "--- BENCHMARK: " << occupancy << " hits/TDC, " << benchmark.getEvents() << " events, "
+	      << benchmark.getHits() << " hits, " << raw.size() << " bytes, "
+	      << tof::data::simd::kKernels << " kernels"
+	      << "\033[0m" << std::endl;
+    printf("\n");
+    printf("    %-8s %12s %12s %10s %8s %8s \n", "stage", "ns/event", "ns/hit", "GB/s", "IPC", "passes");
+    for (auto &result : results) {
+      double nsEvent = result.Seconds * 1.e9 / result.Events;
+      double nsHit = result.Hits > 0 ? result.Seconds * 1.e9 / result.Hits : 0.;
+      double gbs = result.Seconds > 0. ? result.Bytes / result.Seconds / 1.e9 : 0.;
+      double ipc = result.Cycles > 0. ? result.Instructions / result.Cycles : -1.;
+      printf("    %-8s %12.1f ", result.Stage.c_str(), nsEvent);
+      if (result.Hits > 0) printf("%12.2f ", nsHit);
+      else printf("%12s ", "n/a");
+      printf("%10.3f ", gbs);
+      if (ipc >= 0.) printf("%8.2f ", ipc);
+      else printf("%8s ", "n/a");
+      printf("%8ld \n", result.Passes);
+
+      if (json.is_open()) {
+	json << (first ? "\n" : ",\n")
+	     << "    {\"stage\": \"" << result.Stage << "\", \"hits_per_tdc\": " << occupancy
+	     << ", \"events\": " << result.Events << ", \"hits\": " << result.Hits << ", \"bytes\": " << result.Bytes
+	     << ", \"seconds\": " << result.Seconds << ", \"ns_per_event\": " << nsEvent;
+	if (result.Hits > 0) json << ", \"ns_per_hit\": " << nsHit;
+	else json << ", \"ns_per_hit\": null";
+	json << ", \"gb_per_s\": " << gbs;
+	if (ipc >= 0.) json << ", \"ipc\": " << ipc << ", \"instructions\": " << result.Instructions << ", \"cycles\": " << result.Cycles;
+	else json << ", \"ipc\": null";
+	json << "}";
+	first = false;
+      }
+    }
+    printf("\n");
+  }
+
+  if (json.is_open()) {
+    json << "\n  ]\n}\n";
+    json.close();
+  }
+
+  return 0;
+}
@@ -20,6 +20,7 @@
 
 // DRM getters
 #define GET_DRMGLOBALHEADER_DRMID(x)                  ( (x & 0x0FE00000) >> 21 )
+#define GET_DRMGLOBALHEADER_EVENTWORDS(x)             ( (x & 0x001FFFF0) >>  4 )
 #define GET_DRMSTATUSHEADER1_PARTICIPATINGSLOTID(x)   ( (x & 0x00007FF0) >>  4 )
 #define GET_DRMSTATUSHEADER1_CBIT(x)     ( (x & 0x00008000) >>  15 )
 #define GET_DRMSTATUSHEADER2_SLOTENABLEMASK(x)        ( (x & 0x00007FF0) >>  4 )
@@ -42,11 +43,31 @@
 
 // TDC getters
 #define GET_TDCHIT_HITTIME(x)          ( (x & 0x001FFFFF) )
-#define GET_TDCHIT_CHAN(x)             ( (x & 0x00E00000) >>  3 )
+#define GET_TDCHIT_CHAN(x)             ( (x & 0x00E00000) >> 21 )
 #define GET_TDCHIT_TDCID(x)            ( (x & 0x0F000000) >> 24 )
 #define GET_TDCHIT_EBIT(x)             ( (x & 0x10000000) >> 29 )
 #define GET_TDCHIT_PSBITS(x)           ( (x & 0x60000000) >> 29 )
 
+// compressed getters
+#define IS_CRATE_HEADER(x)             ( (x & 0x80000000) == 0x80000000 )
+#define IS_CRATE_TRAILER(x)            ( (x & 0x80000000) == 0x80000000 )
+#define IS_FRAME_HEADER(x)             ( (x & 0x80000000) == 0x00000000 )
+#define GET_CRATEHEADER_BUNCHID(x)           ( (x & 0x00000FFF) )
+#define GET_CRATEHEADER_SLOTENABLEMASK(x)    ( (x & 0x007FF000) >> 12 )
+#define GET_CRATEHEADER_DRMID(x)             ( (x & 0x7F000000) >> 24 )
+#define GET_FRAMEHEADER_NUMBEROFHITS(x)      ( (x & 0x0000FFFF) )
+#define GET_FRAMEHEADER_FRAMEID(x)           ( (x & 0x00FF0000) >> 16 )
+#define GET_FRAMEHEADER_TRMID(x)             ( (x & 0x0F000000) >> 24 )
+#define GET_PACKEDHIT_TOT(x)                 ( (x & 0x000007FF) )
+#define GET_PACKEDHIT_TIME(x)                ( (x & 0x00FFF800) >> 11 )
+#define GET_PACKEDHIT_CHANNEL(x)             ( (x & 0x07000000) >> 24 )
+#define GET_PACKEDHIT_TDCID(x)               ( (x & 0x78000000) >> 27 )
+#define GET_PACKEDHIT_CHAIN(x)               ( (x & 0x80000000) >> 31 )
+#define GET_CRATETRAILER_NUMBEROFDIAGNOSTICS(x) ( (x & 0x0000000F) )
+#define GET_CRATETRAILER_EVENTCOUNTER(x)     ( (x & 0x0000FFF0) >>  4 )
+#define GET_DIAGNOSTIC_SLOTID(x)             ( (x & 0x0000000F) )
+#define GET_DIAGNOSTIC_FAULTBITS(x)          ( (x & 0xFFFFFFF0) >>  4 )
+
 #define DIAGNOSTIC_DRM_HEADER                   0x80000000
 #define DIAGNOSTIC_DRM_TRAILER                  0x40000000
 #define DIAGNOSTIC_DRM_CRC                      0x20000000
@@ -373,12 +394,16 @@ namespace compressed {
 
 namespace summary {
 
+ /**
+  ** per-event state, the fields the decoder and the checker touch for
+  ** every word are packed in the first cache lines and the RDH copies
+  ** follow; the TRM fields are only valid if their generation is the
+  ** one of the event, hence they are not cleared at each event
+  **/
  struct RawSummary_t
  {
-   raw::RDHWord0_t         RDHWord0;
-   raw::RDHWord1_t         RDHWord1;
-   raw::RDHWord2_t         RDHWord2;
-   raw::RDHWord3_t         RDHWord3;
+   uint32_t Generation;
+   uint32_t TRMGeneration[10];
    uint32_t DRMCommonHeader;
    uint32_t DRMOrbitHeader;
    uint32_t DRMGlobalHeader;
@@ -392,13 +417,6 @@ namespace summary {
    uint32_t TRMGlobalTrailer[10];
    uint32_t TRMChainHeader[10][2];
    uint32_t TRMChainTrailer[10][2];
-   uint32_t TDCUnpackedHit[2][15][256];
-   uint8_t  nTDCUnpackedHits[2][15];
-
-   uint32_t FramePackedHit[256][256];
-   uint8_t  nFramePackedHits[256];
-   uint8_t  FirstFilledFrame;
-   uint8_t  LastFilledFrame;
     
    // derived data
    bool HasHits[10];
@@ -412,6 +430,32 @@ namespace summary {
    uint32_t DiagnosticWord[12];
   
    uint32_t faultFlags;
+
+   raw::RDHWord0_t         RDHWord0;
+   raw::RDHWord1_t         RDHWord1;
+   raw::RDHWord2_t         RDHWord2;
+   raw::RDHWord3_t         RDHWord3;
+ };
+
+ /**
+  ** hit storage of the TRM being decoded, allocated apart and cache
+  ** aligned; counters and the frame bitmap come first, then the tables
+  ** that are only touched as far as they are filled
+  **/
+ struct HitSummary_t
+ {
+   uint8_t  nTDCUnpackedHits[2][15];
+   uint32_t nPackedHits;
+   uint64_t FilledFrames[4]; // occupancy bitmap
+   uint16_t nFramePackedHits[256];
+   uint16_t FrameOffset[256];
+
+   uint32_t TDCUnpackedHit[2][15][256];
+
+   /** packed hits of a TRM in spider order, then bucketed by frame **/
+   uint32_t PackedHit[2 * 15 * 256];
+   uint8_t  PackedHitFrame[2 * 15 * 256];
+   uint32_t FramePackedHit[2 * 15 * 256];
  };
 
 } /** namespace summary **/
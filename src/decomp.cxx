@@ -2,13 +2,26 @@
 #include <iostream>
 #include <chrono>
 #include "TOFdecomp.h"
+#include "TOFparallel.h"
+#include "TOFlinks.h"
+#include "TOFpipeline.h"
+#include "TOFreader.h"
+#include "TOFstream.h"
+#include "TOFprobe.h"
 
 int main(int argc, char **argv)
 {
 
-  bool verbose = false, rewind = false;
-  std::string inFileName, outFileName;
+  bool verbose = false, rewind = false, mapped = false, links = false, direct = false, writerThread = false;
+  bool scan = false, scanUnpack = false, pipeline = false, latency = false;
+  std::string inFileName, outFileName, linkOutput, checkLevel = "full", metricsName;
   int drmid = -1;
+  long bufferSize = 8388608;
+  int nThreads = 1, nPagesPerJob = 64, asyncDepth = 0, pipelineDepth = 4;
+  std::vector<int> pinning;
+  long flushSize = 8388608;
+  double flushLatency = 0.;
+  double metricsInterval = 1.;
   
   /** define arguments **/
   namespace po = boost::program_options;
@@ -18,12 +31,29 @@ int main(int argc, char **argv)
     
     desc.add_options()
       ("help", "Print help messages")
-#if defined(DECODER_VERBOSE) || defined(ENCODER_VERBOSE) || defined(CHECKER_VERBOSE)
       ("verbose,v", po::bool_switch(&verbose), "Verbose flag")
-#endif
-      ("verbose,v", po::bool_switch(&verbose), "Verbose flag")
-      ("input,i", po::value<std::string>(&inFileName), "Input data file")
-      ("output,o", po::value<std::string>(&outFileName), "Output data file")
+      ("input,i", po::value<std::string>(&inFileName), "Input data file, named pipe, unix:<path> socket, shm:<name> shared-memory ring or - for stdin")
+      ("output,o", po::value<std::string>(&outFileName), "Output data file, named pipe, unix:<path> socket, - for stdout or null to drop it")
+      ("mmap,m", po::bool_switch(&mapped), "Memory-map the input data file")
+      ("buffer-size,b", po::value<long>(&bufferSize), "Input read buffer size in bytes")
+      ("async,a", po::value<int>(&asyncDepth), "Asynchronous IO with this number of buffers in flight")
+      ("direct", po::bool_switch(&direct), "Read input with O_DIRECT (asynchronous IO only)")
+      ("flush-size", po::value<long>(&flushSize), "Flush the output when this many bytes are buffered")
+      ("flush-latency", po::value<double>(&flushLatency), "Flush the output at least every this many seconds")
+      ("writer-thread", po::bool_switch(&writerThread), "Flush the output from a writer thread")
+      ("threads,t", po::value<int>(&nThreads), "Number of decoding threads")
+      ("pages-per-job", po::value<int>(&nPagesPerJob), "Number of pages per parallel decoding job")
+      ("pipeline", po::bool_switch(&pipeline), "Run read, decode and write as pipeline stages on their own threads")
+      ("pipeline-depth", po::value<int>(&pipelineDepth), "Number of batches of pages in the pipeline")
+      ("pin", po::value<std::vector<int>>(&pinning)->multitoken(), "Cores of the read, decode and write pipeline stages, -1 is not pinned")
+      ("links,l", po::bool_switch(&links), "Decode each RDH link (CruID/FeeID) with its own decoder")
+      ("link-output", po::value<std::string>(&linkOutput), "Write per-link output files with this prefix")
+      ("check", po::value<std::string>(&checkLevel), "Checker level: full, drm (DRM only) or off (no diagnostic words)")
+      ("metrics", po::value<std::string>(&metricsName), "Publish live metrics in the Prometheus text format to this file or on http:<port>")
+      ("metrics-interval", po::value<double>(&metricsInterval), "Seconds between metrics updates")
+      ("latency", po::bool_switch(&latency), "Latency histograms of events, pages and writes, printed at the end and on SIGUSR1")
+      ("scan", po::bool_switch(&scan), "Scan a compressed data file and print statistics")
+      ("scan-unpack", po::bool_switch(&scanUnpack), "Also unpack the hits while scanning")
       ;
     
     po::variables_map vm;
@@ -45,28 +75,115 @@ int main(int argc, char **argv)
     return 1;
   }
   
+  /** scan compressed data **/
+  if (scan && !inFileName.empty()) {
+    auto start = std::chrono::high_resolution_clock::now();
+    tof::data::TOFreader reader;
+    tof::data::TOFreader::Scan_t stats;
+    if (reader.open(inFileName)) return 1;
+    bool error = reader.scan(stats, scanUnpack);
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    tof::data::TOFreader::scanSummary(stats);
+    std::cout << " scan time: " << elapsed.count() << " s ("
+	      << stats.Bytes / elapsed.count() / 1.e9 << " GB/s)" << std::endl;
+    return error ? 1 : 0;
+  }
+
   if (inFileName.empty() || outFileName.empty()) {
     std::cout << desc << std::endl;
     return 1;
   }
+
+  /** console messages must not mix with the data on stdout **/
+  if (outFileName == "-") tof::data::TOFstream::dataStdout();
   
   tof::data::TOFdecomp decomp;
-#ifdef DECODER_VERBOSE
+  if (checkLevel == "full") decomp.setCheckLevel(tof::data::TOFdecomp::kCheckFull);
+  else if (checkLevel == "drm") decomp.setCheckLevel(tof::data::TOFdecomp::kCheckDRM);
+  else if (checkLevel == "off") decomp.setCheckLevel(tof::data::TOFdecomp::kCheckOff);
+  else {
+    std::cerr << "\033[1;31m-E- unknown checker level: " << checkLevel << std::endl;
+    return 1;
+  }
   decomp.setDecoderVerbose(verbose);
-#endif
-#ifdef ENCODER_VERBOSE
   decomp.setEncoderVerbose(verbose);
-#endif
-#ifdef CHECKER_VERBOSE
   decomp.setCheckerVerbose(verbose);
-#endif
+  decomp.setDecoderMapped(mapped);
+  decomp.setDecoderBufferSize(bufferSize);
+  decomp.setAsyncIO(asyncDepth, direct);
+  decomp.setEncoderFlushPolicy(flushSize, flushLatency);
+  decomp.setEncoderThreaded(writerThread);
+  if (latency) {
+    tof::data::TOFlatency::watch();
+    decomp.setLatency(true);
+  }
   decomp.init();
-  if (decomp.open(inFileName, outFileName)) return 1;
+  /** null counts and drops the output **/
+  tof::data::TOFnullSink null;
+  if (outFileName == "null" ? decomp.open(inFileName, null) : decomp.open(inFileName, outFileName)) return 1;
+
+  /** live metrics, published by their own thread **/
+  tof::data::TOFmetrics metrics;
+  if (!metricsName.empty()) {
+    metrics.setInterval(metricsInterval);
+    if (metrics.start(metricsName)) return 1;
+    decomp.setMetrics(&metrics);
+  }
+
+  /** per-link decoding **/
+  if (links) {
+    auto start = std::chrono::high_resolution_clock::now();
+    tof::data::TOFlinks linkDecoder(nThreads);
+    linkDecoder.setLinkOutput(linkOutput);
+    if (linkDecoder.init(decomp) || linkDecoder.run(decomp)) return 1;
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    decomp.close();
+    decomp.stopMetrics();
+    linkDecoder.checkSummary();
+    decomp.checkSummary();
+    TOF_PROBE_REPORT();
+    decomp.latencySummary();
+    std::cout << " local benchmark: " << elapsed.count() << " s (" << nThreads << " threads)" << std::endl;
+    return 0;
+  }
+
+  /** pipelined decoding **/
+  if (pipeline) {
+    auto start = std::chrono::high_resolution_clock::now();
+    tof::data::TOFpipeline stages(pipelineDepth);
+    stages.setPinning(pinning);
+    if (stages.init(decomp) || stages.run(decomp)) return 1;
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    decomp.close();
+    decomp.stopMetrics();
+    stages.summary();
+    decomp.checkSummary();
+    TOF_PROBE_REPORT();
+    decomp.latencySummary();
+    std::cout << " local benchmark: " << elapsed.count() << " s (pipeline)" << std::endl;
+    return 0;
+  }
+
+  /** parallel decoding **/
+  if (nThreads > 1) {
+    auto start = std::chrono::high_resolution_clock::now();
+    tof::data::TOFparallel parallel(nThreads, nPagesPerJob);
+    if (parallel.init(decomp) || parallel.run(decomp)) return 1;
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    decomp.close();
+    decomp.stopMetrics();
+    decomp.checkSummary();
+    TOF_PROBE_REPORT();
+    decomp.latencySummary();
+    std::cout << " local benchmark: " << elapsed.count() << " s (" << nThreads << " threads)" << std::endl;
+    return 0;
+  }
 
   /** chrono **/
   std::chrono::time_point<std::chrono::high_resolution_clock> start, finish;
   std::chrono::duration<double> elapsed;
-  double integratedTime;
+  double integratedTime = 0.;
+  auto wallStart = std::chrono::high_resolution_clock::now();
  
   /** loop over pages **/
   while (!decomp.read()) {
@@ -74,29 +191,15 @@ int main(int argc, char **argv)
     /** get start chrono **/
     start = std::chrono::high_resolution_clock::now();	
     
-    /** decode RDH open **/
+    /** decode RDH **/
     decomp.decodeRDH();
     
-    /** decode loop **/
-    for (int i = 0; i < 3 && !decomp.decode(); ++i) {
+    /** decode loop, until the page memory is exhausted **/
+    while (!decomp.decode()) {
       decomp.write();
     }
     /** end of decode loop **/
 
-    /** pause chrono for IO operation **/
-    finish = std::chrono::high_resolution_clock::now();
-    elapsed = finish - start;
-    integratedTime += elapsed.count();
-    
-    /** read page **/
-    decomp.read();
-
-    /** restart chrono after IO operation **/
-    start = std::chrono::high_resolution_clock::now();
-    
-    /** decode RDH close **/
-    decomp.decodeRDH();
-    
     /** get finish chrono and increment **/
     finish = std::chrono::high_resolution_clock::now();
     elapsed = finish - start;
@@ -105,9 +208,14 @@ int main(int argc, char **argv)
   } /** end of loop over pages **/
   
   decomp.close();
+  decomp.stopMetrics();
+  std::chrono::duration<double> wallTime = std::chrono::high_resolution_clock::now() - wallStart;
   decomp.checkSummary();
+  TOF_PROBE_REPORT();
+  decomp.latencySummary();
   
   std::cout << " local benchmark: " << integratedTime << " s" << std::endl;
+  std::cout << " wall time: " << wallTime.count() << " s" << std::endl;
 
   return 0;
 }
@@ -0,0 +1,92 @@
+#include <boost/program_options.hpp>
+#include <iostream>
+#include "TOFgenerator.h"
+
+int main(int argc, char **argv)
+{
+
+  std::string outFileName;
+  long nEvents = 1000;
+  uint64_t seed = 1;
+  double hitsPerTDC = 1., trailingFraction = 1., trmFraction = 1., faultRate = 0.;
+  int eventsPerPage = 1, links = 1, feeID = 0, cruID = 0, drmID = 0;
+  long pageSize = 8192;
+  bool ltm = false;
+  double faultRates[tof::data::TOFgenerator::kNFaults];
+  for (auto &rate : faultRates) rate = -1.;
+
+  /** define arguments **/
+  namespace po = boost::program_options;
+  po::options_description desc("Options");
+  po::options_description faults("Fault injection rates (override --fault-rate)");
+
+  try {
+
+    desc.add_options()
+      ("help", "Print help messages")
+      ("output,o", po::value<std::string>(&outFileName), "Output raw data file")
+      ("events,n", po::value<long>(&nEvents), "Number of events")
+      ("seed,s", po::value<uint64_t>(&seed), "Random seed")
+      ("hits-per-tdc", po::value<double>(&hitsPerTDC), "Mean number of leading hits per TDC and chain")
+      ("trailing-fraction", po::value<double>(&trailingFraction), "Fraction of leading hits followed by a trailing hit")
+      ("trm-fraction", po::value<double>(&trmFraction), "Fraction of participating TRMs")
+      ("ltm", po::bool_switch(&ltm), "Add LTM data to each event")
+      ("events-per-page", po::value<int>(&eventsPerPage), "Maximum number of events per page, 0 fills pages")
+      ("page-size", po::value<long>(&pageSize), "Page size in bytes")
+      ("links", po::value<int>(&links), "Number of links, pages alternate between consecutive FeeIDs")
+      ("fee-id", po::value<int>(&feeID), "FeeID of the first link")
+      ("cru-id", po::value<int>(&cruID), "CruID")
+      ("drm-id", po::value<int>(&drmID), "DRMID")
+      ("fault-rate", po::value<double>(&faultRate), "Injection rate of all faults")
+      ;
+    for (int ifault = 0; ifault < tof::data::TOFgenerator::kNFaults; ++ifault)
+      faults.add_options()
+	(tof::data::TOFgenerator::getFaultName(ifault), po::value<double>(&faultRates[ifault]), tof::data::TOFgenerator::getFaultDescription(ifault));
+    desc.add(faults);
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+
+    /** process arguments **/
+
+    /** help **/
+    if (vm.count("help")) {
+      std::cout << desc << std::endl;
+      return 1;
+    }
+    po::notify(vm);
+
+  }
+  catch(std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    std::cout << desc << std::endl;
+    return 1;
+  }
+
+  if (outFileName.empty()) {
+    std::cout << desc << std::endl;
+    return 1;
+  }
+
+  tof::data::TOFgenerator generator;
+  generator.setSeed(seed);
+  generator.setHitsPerTDC(hitsPerTDC);
+  generator.setTrailingFraction(trailingFraction);
+  generator.setTRMFraction(trmFraction);
+  generator.setLTM(ltm);
+  generator.setEventsPerPage(eventsPerPage);
+  generator.setPageSize(pageSize);
+  generator.setLinks(links);
+  generator.setFeeID(feeID);
+  generator.setCruID(cruID);
+  generator.setDRMID(drmID);
+  for (int ifault = 0; ifault < tof::data::TOFgenerator::kNFaults; ++ifault)
+    generator.setFaultRate(ifault, faultRates[ifault] < 0. ? faultRate : faultRates[ifault]);
+
+  if (generator.open(outFileName)) return 1;
+  if (generator.generate(nEvents)) return 1;
+  generator.close();
+  generator.summary();
+
+  return 0;
+}
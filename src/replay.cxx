@@ -0,0 +1,161 @@
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "TOFstream.h"
+#include "TOFring.h"
+#include "TOFpageWalker.h"
+
+/**
+ ** stand-in for the readout process: replays a raw data file into a
+ ** socket, a named pipe or the standard output at a given line rate,
+ ** in chunks that do not respect the page boundaries, or page by page
+ ** into a shared-memory ring
+ **/
+
+namespace {
+
+  /** wait until the bytes written so far are due at the line rate **/
+  void
+  pace(std::chrono::steady_clock::time_point start, long bytes, double rate)
+  {
+    if (rate <= 0.) return;
+    std::chrono::duration<double> due(8. * bytes / (rate * 1.e9));
+    std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(due));
+  }
+
+  /** map the file and push its pages into the ring, returns the bytes pushed or -1 **/
+  long
+  replayRing(tof::data::TOFring &ring, std::string inFileName, int loops, double rate)
+  {
+    int fd = ::open(inFileName.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1 || st.st_size == 0) {
+      std::cerr << "\033[1;31m-E- Cannot open input file or file is empty: " << inFileName << std::endl;
+      if (fd != -1) ::close(fd);
+      return -1;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+      std::cerr << "\033[1;31m-E- Cannot map input file: " << inFileName << std::endl;
+      return -1;
+    }
+    long bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int iloop = 0; iloop < loops && bytes >= 0; ++iloop) {
+      tof::data::TOFpageWalker walker((const char *)map, (const char *)map + st.st_size);
+      while (!walker.next()) {
+	if (ring.push(walker.page(), walker.pageSize())) {
+	  bytes = -1;
+	  break;
+	}
+	bytes += walker.pageSize();
+	pace(start, bytes, rate);
+      }
+    }
+    munmap(map, st.st_size);
+    return bytes;
+  }
+
+}
+
+int main(int argc, char **argv)
+{
+
+  std::string inFileName, outFileName;
+  double rate = 3.2;
+  long chunkSize = 65536;
+  int loops = 1;
+  long ringSize = 67108864;
+
+  /** define arguments **/
+  namespace po = boost::program_options;
+  po::options_description desc("Options");
+
+  try {
+
+    desc.add_options()
+      ("help", "Print help messages")
+      ("input,i", po::value<std::string>(&inFileName), "Input raw data file")
+      ("output,o", po::value<std::string>(&outFileName), "Output stream: unix:<path> (listen for one consumer), shm:<name> (shared-memory ring), a named pipe or - for stdout")
+      ("rate,r", po::value<double>(&rate), "Line rate in Gb/s, 0 is as fast as possible")
+      ("chunk-size", po::value<long>(&chunkSize), "Bytes per write")
+      ("loops", po::value<int>(&loops), "Number of times the file is replayed")
+      ("ring-size", po::value<long>(&ringSize), "Bytes of pages in the shared-memory ring")
+      ;
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+
+    /** process arguments **/
+
+    /** help **/
+    if (vm.count("help")) {
+      std::cout << desc << std::endl;
+      return 1;
+    }
+    po::notify(vm);
+
+  }
+  catch(std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    std::cout << desc << std::endl;
+    return 1;
+  }
+
+  if (inFileName.empty() || outFileName.empty() || chunkSize <= 0) {
+    std::cout << desc << std::endl;
+    return 1;
+  }
+
+  /** console messages must not mix with the data **/
+  if (outFileName == "-") tof::data::TOFstream::dataStdout();
+
+  long bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  /** shared-memory ring, removed once the consumer released all pages **/
+  bool ringOutput = tof::data::TOFring::isRing(outFileName);
+  if (ringOutput) {
+    tof::data::TOFring ring;
+    if (ring.create(outFileName, ringSize)) return 1;
+    std::cout << "\033[1;34m"
+	      << "--- RING CREATED: " << tof::data::TOFring::ringName(outFileName) << ", " << ringSize << " bytes"
+	      << "\033[0m" << std::endl;
+    bytes = replayRing(ring, inFileName, loops, rate);
+    if (bytes < 0) return 1;
+    ring.finish();
+    ring.close();
+  }
+
+  tof::data::TOFstream output;
+  if (!ringOutput && output.openOutput(outFileName)) return 1;
+
+  std::vector<char> chunk(chunkSize);
+  for (int iloop = 0; iloop < loops && output.isOpen(); ++iloop) {
+    tof::data::TOFstream input;
+    if (input.open(inFileName)) return 1;
+    long nread;
+    while ((nread = input.read(chunk.data(), chunkSize)) > 0) {
+      if (output.write(chunk.data(), nread)) return 1;
+      bytes += nread;
+      pace(start, bytes, rate);
+    }
+    if (nread < 0) return 1;
+  }
+  output.close();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "\033[1;34m"
+	    << "--- REPLAY: " << bytes << " bytes in " << elapsed.count() << " s ("
+	    << 8. * bytes / elapsed.count() / 1.e9 << " Gb/s)"
+	    << "\033[0m" << std::endl;
+
+  return 0;
+}